@@ -20,14 +20,50 @@ THE SOFTWARE.
 #include "pedeps_version.h"
 #include "pedeps.h"
 #include "pestructs.h"
+#include "pethread.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <wchar.h>
 #include <inttypes.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+//atomic operations used to allow concurrent queries on the same handle
+#if defined(__GNUC__) || defined(__clang__)
+#define pe_atomic_load(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define pe_atomic_store(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define pe_atomic_load_relaxed(p) __atomic_load_n(p, __ATOMIC_RELAXED)
+#define pe_atomic_store_relaxed(p, v) __atomic_store_n(p, v, __ATOMIC_RELAXED)
+#elif defined(_WIN32)
+#define pe_atomic_load(p) (MemoryBarrier(), *(p))
+#define pe_atomic_store(p, v) (MemoryBarrier(), *(p) = (v))
+#define pe_atomic_load_relaxed(p) (*(p))
+#define pe_atomic_store_relaxed(p, v) (*(p) = (v))
+#else
+#error No atomic operations available for this compiler
+#endif
 
 #define READ_STRING_STEP 32
+#define READ_STRING_BUFFER_STEP 256
+#define CACHE_PROBE_SLOTS 4
+#define IMPORT_LOOKUP_BLOCK 256
+#define PE_IMPORT_LOOKUP_BY_ORDINAL 0x80000000
+#define PE_INVALID_OFFSET UINT64_MAX
+#define ARENA_ALIGNMENT 16
+#define ARENA_CHUNK_SIZE 65536
+#define ARENA_RETAIN_SIZE (1024 * 1024)
+#define PROBE_PREFIX_SIZE 4096
+#define EXPORT_DIRECTORY_MAX_CACHE (16 * 1024 * 1024)
 
 DLL_EXPORT_PEDEPS void pedeps_get_version (int* pmajor, int* pminor, int* pmicro)
 {
@@ -46,253 +82,832 @@ DLL_EXPORT_PEDEPS const char* pedeps_get_version_string ()
 
 ////////////////////////////////////////////////////////////////////////
 
+struct pefile_cache_block_struct {
+  uint64_t blockindex;
+  uint64_t datalen;
+  uint64_t lastused;
+  int used;
+};
+
+struct pefile_arena_chunk_struct {
+  struct pefile_arena_chunk_struct* next;
+  size_t size;
+  size_t used;
+};
+
+#define ARENA_CHUNK_HEADER_SIZE ((sizeof(struct pefile_arena_chunk_struct) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+struct pefile_arena_struct {
+  struct pefile_arena_chunk_struct* first;
+  struct pefile_arena_chunk_struct* current;
+  struct pefile_arena_struct* next;
+};
+
+struct pefile_arena_mark_struct {
+  struct pefile_arena_chunk_struct* chunk;
+  size_t used;
+};
+
+struct pefile_string_buffer_struct {
+  char* data;
+  size_t dataallocated;
+  struct pefile_arena_struct* arena;
+};
+
+
+struct pefile_export_cache_struct {
+  int loaded;
+  uint32_t directoryrva;
+  uint32_t directorylength;
+  uint32_t base;
+  uint32_t functioncount;
+  uint32_t namecount;
+  const uint32_t* functionaddr;
+  const uint32_t* functionnamerva;
+  const uint16_t* functionnameordinal;
+  const uint8_t* directorydata;
+  void* data;
+};
+
 struct pefile_struct {
+  PEmem_malloc_fn malloc_fn;
+  PEmem_realloc_fn realloc_fn;
+  PEmem_free_fn free_fn;
+  void* memuserdata;
+  PEio_pread_fn pread_fn;
   PEio_read_fn read_fn;
   PEio_tell_fn tell_fn;
   PEio_seek_fn seek_fn;
   PEio_close_fn close_fn;
   void* iohandle;
+  const uint8_t* imagedata;
+  uint64_t imagedatalen;
+  int imagemapped;
+  size_t cacheblocksize;
+  size_t cacheblockcount;
+  uint8_t* cachedata;
+  struct pefile_cache_block_struct* cacheblocks;
+  uint64_t cachetick;
+  uint64_t cachehits;
+  uint64_t cachemisses;
+  pe_mutex iolock;
+  pe_mutex initlock;
+  struct pefile_arena_struct arena;
+  struct pefile_arena_struct* arenapool;
   struct PEheader_DOS dosheader;
   struct PEheader_PE peheader;
   struct PEheader_COFF coffheader;
   union PEheader_optional* optionalheader;
   struct PEheader_data_directory* datadir;
   struct PEheader_optional_commonext* pecommonext;
+  uint64_t sectiontablepos;
+  int sectionsloaded;
+  void* sectiondata;
+  size_t sectiondataallocated;
   struct peheader_imagesection* sections;
+  uint16_t* sectionorder;
+  uint16_t lastsection;
+  struct pefile_imports_struct* importtable;
+  struct pefile_export_cache_struct exportcache;
 };
 
 ////////////////////////////////////////////////////////////////////////
 
-static inline struct peheader_imagesection* find_section (pefile_handle pe_file, uint32_t rva)
+static void* default_malloc (size_t size, void* userdata)
 {
-  return pe_find_rva_section(pe_file->sections, pe_file->coffheader.NumberOfSections, rva);
+  return malloc(size);
 }
 
-void* read_data_at (pefile_handle pe_file, uint32_t offset, void* buf, size_t buflen)
+static void* default_realloc (void* ptr, size_t size, void* userdata)
 {
-  uint64_t origfilepos;
-  void* data;
-  //allocate buffer dynamically if NULL pointer was given
-  if (!buf) {
-    if ((data = malloc(buflen)) == NULL)
-      return NULL;
+  return realloc(ptr, size);
+}
+
+static void default_free (void* ptr, void* userdata)
+{
+  free(ptr);
+}
+
+static PEmem_malloc_fn global_malloc_fn = default_malloc;
+static PEmem_realloc_fn global_realloc_fn = default_realloc;
+static PEmem_free_fn global_free_fn = default_free;
+static void* global_memuserdata = NULL;
+
+DLL_EXPORT_PEDEPS void pedeps_set_allocator (PEmem_malloc_fn malloc_fn, PEmem_realloc_fn realloc_fn, PEmem_free_fn free_fn, void* userdata)
+{
+  if (malloc_fn && realloc_fn && free_fn) {
+    global_malloc_fn = malloc_fn;
+    global_realloc_fn = realloc_fn;
+    global_free_fn = free_fn;
+    global_memuserdata = userdata;
   } else {
-    data = buf;
+    global_malloc_fn = default_malloc;
+    global_realloc_fn = default_realloc;
+    global_free_fn = default_free;
+    global_memuserdata = NULL;
   }
-  //remember original file position
-  origfilepos = (pe_file->tell_fn)(pe_file->iohandle);
-  //read data at position
-  if ((pe_file->seek_fn)(pe_file->iohandle, offset) != 0 || (pe_file->read_fn)(pe_file->iohandle, data, buflen) < buflen) {
-    if (!buf)
-      free(data);
-    data = NULL;
+}
+
+//allocate memory using the allocation functions of the handle
+static inline void* pe_malloc (pefile_handle pe_file, size_t size)
+{
+  return (pe_file->malloc_fn)(size, pe_file->memuserdata);
+}
+
+//resize memory using the allocation functions of the handle
+static inline void* pe_realloc (pefile_handle pe_file, void* ptr, size_t size)
+{
+  return (pe_file->realloc_fn)(ptr, size, pe_file->memuserdata);
+}
+
+//free memory using the allocation functions of the handle
+static inline void pe_free (pefile_handle pe_file, void* ptr)
+{
+  if (ptr)
+    (pe_file->free_fn)(ptr, pe_file->memuserdata);
+}
+
+//allocate memory from an arena (released in bulk by arena_release() or arena_reset())
+static void* arena_alloc (pefile_handle pe_file, struct pefile_arena_struct* arena, size_t size)
+{
+  struct pefile_arena_chunk_struct* chunk;
+  struct pefile_arena_chunk_struct* lastchunk = NULL;
+  size_t chunksize;
+  void* data;
+  if (size > SIZE_MAX - ARENA_CHUNK_HEADER_SIZE - ARENA_ALIGNMENT)
+    return NULL;
+  size = (size ? (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1) : ARENA_ALIGNMENT);
+  //use the current chunk or move on to the next chunk already allocated if there is not enough space
+  chunk = arena->current;
+  while (chunk && chunk->size - chunk->used < size) {
+    lastchunk = chunk;
+    if ((chunk = chunk->next) != NULL)
+      chunk->used = 0;
   }
-  //restore original file position
-  (pe_file->seek_fn)(pe_file->iohandle, origfilepos);
+  //allocate new chunk at the end of the list
+  if (!chunk) {
+    chunksize = (size > ARENA_CHUNK_SIZE - ARENA_CHUNK_HEADER_SIZE ? ARENA_CHUNK_HEADER_SIZE + size : ARENA_CHUNK_SIZE);
+    if ((chunk = (struct pefile_arena_chunk_struct*)pe_malloc(pe_file, chunksize)) == NULL)
+      return NULL;
+    chunk->next = NULL;
+    chunk->size = chunksize - ARENA_CHUNK_HEADER_SIZE;
+    chunk->used = 0;
+    if (lastchunk)
+      lastchunk->next = chunk;
+    else
+      arena->first = chunk;
+  }
+  arena->current = chunk;
+  data = (uint8_t*)chunk + ARENA_CHUNK_HEADER_SIZE + chunk->used;
+  chunk->used += size;
   return data;
 }
 
-char* read_string_at (pefile_handle pe_file, uint32_t offset)
+//get current arena position
+static inline struct pefile_arena_mark_struct arena_mark (struct pefile_arena_struct* arena)
+{
+  struct pefile_arena_mark_struct mark;
+  mark.chunk = arena->current;
+  mark.used = (mark.chunk ? mark.chunk->used : 0);
+  return mark;
+}
+
+//release all memory allocated from the arena since the position was obtained with arena_mark()
+static inline void arena_release (struct pefile_arena_struct* arena, struct pefile_arena_mark_struct mark)
+{
+  if ((arena->current = (mark.chunk ? mark.chunk : arena->first)) != NULL)
+    arena->current->used = mark.used;
+}
+
+//release all memory allocated from the arena, keeping chunks up to ARENA_RETAIN_SIZE for reuse
+static void arena_reset (pefile_handle pe_file, struct pefile_arena_struct* arena)
+{
+  struct pefile_arena_chunk_struct* chunk;
+  struct pefile_arena_chunk_struct* nextchunk;
+  size_t retained;
+  if ((chunk = arena->first) != NULL) {
+    retained = chunk->size;
+    while (chunk->next && chunk->next->size <= ARENA_RETAIN_SIZE - retained) {
+      chunk = chunk->next;
+      retained += chunk->size;
+    }
+    nextchunk = chunk->next;
+    chunk->next = NULL;
+    while (nextchunk) {
+      chunk = nextchunk;
+      nextchunk = chunk->next;
+      pe_free(pe_file, chunk);
+    }
+    arena->first->used = 0;
+  }
+  arena->current = arena->first;
+}
+
+//free all memory of the arena
+static void arena_free (pefile_handle pe_file, struct pefile_arena_struct* arena)
+{
+  struct pefile_arena_chunk_struct* chunk;
+  while ((chunk = arena->first) != NULL) {
+    arena->first = chunk->next;
+    pe_free(pe_file, chunk);
+  }
+  arena->current = NULL;
+}
+
+//get an arena for use by a single thread, taken from the pool of the handle if available (returns NULL on error)
+static struct pefile_arena_struct* arena_acquire (pefile_handle pe_file)
+{
+  struct pefile_arena_struct* arena;
+  pe_mutex_lock(&(pe_file->iolock));
+  if ((arena = pe_file->arenapool) != NULL)
+    pe_file->arenapool = arena->next;
+  pe_mutex_unlock(&(pe_file->iolock));
+  if (!arena && (arena = (struct pefile_arena_struct*)pe_malloc(pe_file, sizeof(struct pefile_arena_struct))) != NULL) {
+    arena->first = NULL;
+    arena->current = NULL;
+  }
+  return arena;
+}
+
+//release all memory allocated from an arena obtained with arena_acquire() and put it back in the pool of the handle
+static void arena_giveback (pefile_handle pe_file, struct pefile_arena_struct* arena)
+{
+  if (!arena)
+    return;
+  arena_reset(pe_file, arena);
+  pe_mutex_lock(&(pe_file->iolock));
+  arena->next = pe_file->arenapool;
+  pe_file->arenapool = arena;
+  pe_mutex_unlock(&(pe_file->iolock));
+}
+
+//get pointer to data inside the image data in memory (returns NULL if not in memory or out of bounds)
+static inline const void* get_image_data (pefile_handle pe_file, uint64_t offset, uint64_t datalen)
+{
+  if (!pe_file->imagedata || offset > pe_file->imagedatalen || datalen > pe_file->imagedatalen - offset)
+    return NULL;
+  return pe_file->imagedata + offset;
+}
+
+//read data at specified position using the I/O functions, returns number of bytes read (iolock must be held unless pread_fn is set)
+static uint64_t read_io_at_unlocked (pefile_handle pe_file, uint64_t offset, void* buf, uint64_t buflen)
 {
   uint64_t origfilepos;
-  char* data = NULL;
-  size_t dataallocated = 0;
-  size_t datalen = 0;
+  uint64_t len;
+  //use positional read function if available
+  if (pe_file->pread_fn)
+    return (pe_file->pread_fn)(pe_file->iohandle, offset, buf, buflen);
   //remember original file position
   origfilepos = (pe_file->tell_fn)(pe_file->iohandle);
   //read data at position
-  if ((pe_file->seek_fn)(pe_file->iohandle, offset) == 0 && (data = (char*)malloc(dataallocated = READ_STRING_STEP)) != NULL) {
-    size_t i;
-    size_t len;
-    //read next block
-    while ((len = (pe_file->read_fn)(pe_file->iohandle, data + datalen, READ_STRING_STEP)) > 0) {
-      //done if terminating zero was found
-      for (i = datalen; i < datalen + len; i++) {
-        if (!data[i])
-          break;
-      }
-      datalen += len;
-      if (i < datalen)
+  if ((pe_file->seek_fn)(pe_file->iohandle, offset) != 0)
+    len = 0;
+  else
+    len = (pe_file->read_fn)(pe_file->iohandle, buf, buflen);
+  //restore original file position
+  (pe_file->seek_fn)(pe_file->iohandle, origfilepos);
+  return len;
+}
+
+//read data at specified position using the I/O functions, returns number of bytes read
+static uint64_t read_io_at (pefile_handle pe_file, uint64_t offset, void* buf, uint64_t buflen)
+{
+  uint64_t len;
+  //positional reads don't depend on a shared file position, seek and read must not be interrupted by other threads
+  if (pe_file->pread_fn)
+    return (pe_file->pread_fn)(pe_file->iohandle, offset, buf, buflen);
+  pe_mutex_lock(&(pe_file->iolock));
+  len = read_io_at_unlocked(pe_file, offset, buf, buflen);
+  pe_mutex_unlock(&(pe_file->iolock));
+  return len;
+}
+
+//mark all cache blocks as unused
+static void cache_invalidate (pefile_handle pe_file)
+{
+  size_t i;
+  for (i = 0; i < pe_file->cacheblockcount; i++)
+    pe_file->cacheblocks[i].used = 0;
+}
+
+//get cache block containing the specified block index, reading it if needed (iolock must be held)
+static struct pefile_cache_block_struct* cache_get_block (pefile_handle pe_file, uint64_t blockindex)
+{
+  size_t i;
+  size_t slot;
+  size_t firstslot;
+  struct pefile_cache_block_struct* block;
+  struct pefile_cache_block_struct* victim = NULL;
+  //look for block in the slots where it can be stored, remember least recently used slot
+  firstslot = (size_t)((blockindex * 0x9E3779B97F4A7C15ULL) % pe_file->cacheblockcount);
+  for (i = 0; i < CACHE_PROBE_SLOTS && i < pe_file->cacheblockcount; i++) {
+    slot = (firstslot + i) % pe_file->cacheblockcount;
+    block = &(pe_file->cacheblocks[slot]);
+    if (block->used && block->blockindex == blockindex) {
+      pe_file->cachehits++;
+      block->lastused = ++pe_file->cachetick;
+      return block;
+    }
+    if (!victim || !block->used || (victim->used && block->lastused < victim->lastused))
+      victim = block;
+  }
+  //read block in least recently used slot
+  pe_file->cachemisses++;
+  victim->blockindex = blockindex;
+  victim->lastused = ++pe_file->cachetick;
+  victim->datalen = read_io_at_unlocked(pe_file, blockindex * pe_file->cacheblocksize, pe_file->cachedata + (victim - pe_file->cacheblocks) * pe_file->cacheblocksize, pe_file->cacheblocksize);
+  //only keep a short block if it is the last block of the file (a failed read is tried again next time)
+  victim->used = 1;
+  if (victim->datalen < pe_file->cacheblocksize) {
+    uint8_t nextbyte;
+    if (victim->datalen == 0 || read_io_at_unlocked(pe_file, blockindex * pe_file->cacheblocksize + victim->datalen, &nextbyte, 1) != 0)
+      victim->used = 0;
+  }
+  return victim;
+}
+
+//read data at specified position, returns number of bytes read
+static uint64_t read_at (pefile_handle pe_file, uint64_t offset, void* buf, uint64_t buflen)
+{
+  uint64_t len;
+  if (offset == PE_INVALID_OFFSET)
+    return 0;
+  //copy data from memory
+  if (pe_file->imagedata) {
+    if (offset >= pe_file->imagedatalen)
+      return 0;
+    if ((len = pe_file->imagedatalen - offset) > buflen)
+      len = buflen;
+    memcpy(buf, pe_file->imagedata + offset, len);
+    return len;
+  }
+  //read data through block cache if enabled (except for data that would fill most of the cache)
+  if (pe_file->cacheblockcount && buflen <= pe_file->cacheblocksize * pe_file->cacheblockcount / 2) {
+    struct pefile_cache_block_struct* block;
+    uint64_t blockoffset;
+    uint64_t total = 0;
+    pe_mutex_lock(&(pe_file->iolock));
+    while (total < buflen) {
+      block = cache_get_block(pe_file, (offset + total) / pe_file->cacheblocksize);
+      blockoffset = (offset + total) % pe_file->cacheblocksize;
+      if (blockoffset >= block->datalen)
         break;
-      //allocate more data
-      if ((data = (char*)realloc(data, dataallocated += READ_STRING_STEP)) == NULL) {
-        free(data);
-        data = NULL;
+      if ((len = block->datalen - blockoffset) > buflen - total)
+        len = buflen - total;
+      memcpy((uint8_t*)buf + total, pe_file->cachedata + (block - pe_file->cacheblocks) * pe_file->cacheblocksize + blockoffset, len);
+      total += len;
+      //stop at end of file
+      if (block->datalen < pe_file->cacheblocksize)
         break;
-      }
     }
+    pe_mutex_unlock(&(pe_file->iolock));
+    return total;
   }
-  //restore original file position
-  (pe_file->seek_fn)(pe_file->iohandle, origfilepos);
+  return read_io_at(pe_file, offset, buf, buflen);
+}
+
+//build index of sections sorted by RVA (insertion sort as sections are normally already in order)
+static void build_section_order (struct peheader_imagesection* sections, uint16_t sectioncount, uint16_t* order)
+{
+  uint16_t i;
+  uint16_t j;
+  uint16_t current;
+  for (i = 0; i < sectioncount; i++) {
+    current = i;
+    for (j = i; j > 0 && sections[order[j - 1]].VirtualAddress > sections[current].VirtualAddress; j--)
+      order[j] = order[j - 1];
+    order[j] = current;
+  }
+}
+
+//load section table and build index of sections sorted by RVA, returns non-zero on error
+//the memory is allocated with the allocation functions of the handle and kept for reuse when the next file is opened
+static int load_section_table (pefile_handle pe_file)
+{
+  size_t tablelen;
+  size_t needed;
+  void* data;
+  tablelen = sizeof(struct peheader_imagesection) * pe_file->coffheader.NumberOfSections;
+  //use section table in memory directly if properly aligned
+  if ((pe_file->sections = (struct peheader_imagesection*)get_image_data(pe_file, pe_file->sectiontablepos, tablelen)) != NULL && ((uintptr_t)pe_file->sections % sizeof(uint32_t)) != 0)
+    pe_file->sections = NULL;
+  //make sure buffer is large enough to hold the section table (if not in memory) and the index
+  needed = (pe_file->sections ? 0 : tablelen) + sizeof(uint16_t) * pe_file->coffheader.NumberOfSections;
+  //an empty section table still needs a buffer so it is recognized as loaded
+  if (needed == 0)
+    needed = sizeof(uint16_t);
+  if (needed > pe_file->sectiondataallocated) {
+    if ((data = pe_realloc(pe_file, pe_file->sectiondata, needed)) == NULL) {
+      pe_file->sections = NULL;
+      return 1;
+    }
+    pe_file->sectiondata = data;
+    pe_file->sectiondataallocated = needed;
+  }
+  //read section table
+  if (!pe_file->sections) {
+    if (tablelen > 0 && read_at(pe_file, pe_file->sectiontablepos, pe_file->sectiondata, tablelen) < tablelen)
+      return 1;
+    pe_file->sections = (struct peheader_imagesection*)pe_file->sectiondata;
+  }
+  //build index
+  pe_file->sectionorder = (uint16_t*)((uint8_t*)pe_file->sectiondata + ((void*)pe_file->sections == pe_file->sectiondata ? tablelen : 0));
+  build_section_order(pe_file->sections, pe_file->coffheader.NumberOfSections, pe_file->sectionorder);
+  pe_file->lastsection = 0;
+  return 0;
+}
+
+//load section table the first time it is needed, returns non-zero on error
+static int load_sections (pefile_handle pe_file)
+{
+  int result;
+  if (pe_atomic_load(&(pe_file->sectionsloaded)))
+    return (pe_file->sections ? 0 : 1);
+  //only one thread loads the section table, others wait until it's done
+  pe_mutex_lock(&(pe_file->initlock));
+  if (!pe_file->sectionsloaded) {
+    result = load_section_table(pe_file);
+    pe_atomic_store(&(pe_file->sectionsloaded), 1);
+  } else {
+    result = (pe_file->sections ? 0 : 1);
+  }
+  pe_mutex_unlock(&(pe_file->initlock));
+  return result;
+}
+
+static inline int is_rva_in_section (struct peheader_imagesection* section, uint32_t rva)
+{
+  return (rva >= section->VirtualAddress && rva - section->VirtualAddress < section->SizeOfRawData);
+}
+
+//find section containing RVA using the last section found or a binary search in the sections sorted by RVA
+static struct peheader_imagesection* find_section (pefile_handle pe_file, uint32_t rva)
+{
+  struct peheader_imagesection* section;
+  uint16_t first;
+  uint16_t last;
+  uint16_t middle;
+  if (load_sections(pe_file) != 0 || pe_file->coffheader.NumberOfSections == 0)
+    return NULL;
+  //check last section found (only a hint, so other threads updating it concurrently don't matter)
+  section = &(pe_file->sections[pe_atomic_load_relaxed(&(pe_file->lastsection))]);
+  if (is_rva_in_section(section, rva))
+    return section;
+  //find last section starting at or before RVA
+  first = 0;
+  last = pe_file->coffheader.NumberOfSections;
+  while (first < last) {
+    middle = first + (last - first) / 2;
+    if (pe_file->sections[pe_file->sectionorder[middle]].VirtualAddress <= rva)
+      first = middle + 1;
+    else
+      last = middle;
+  }
+  if (first == 0)
+    return NULL;
+  section = &(pe_file->sections[pe_file->sectionorder[first - 1]]);
+  if (!is_rva_in_section(section, rva))
+    return NULL;
+  pe_atomic_store_relaxed(&(pe_file->lastsection), pe_file->sectionorder[first - 1]);
+  return section;
+}
+
+//get file position of RVA (returns PE_INVALID_OFFSET if RVA is not stored in the file)
+static uint64_t rva_to_offset (pefile_handle pe_file, uint32_t rva)
+{
+  struct peheader_imagesection* section;
+  if ((section = find_section(pe_file, rva)) != NULL)
+    return (uint64_t)rva - section->VirtualAddress + section->PointerToRawData;
+  //RVA in headers
+  if (pe_file->pecommonext && rva < pe_file->pecommonext->SizeOfHeaders)
+    return rva;
+  return PE_INVALID_OFFSET;
+}
+
+//get data at specified position, either pointing inside the image data in memory or allocated from the arena
+static void* read_arena_data_at (pefile_handle pe_file, struct pefile_arena_struct* arena, uint64_t offset, size_t buflen)
+{
+  void* data;
+  //use data in memory directly if data is properly aligned
+  if ((data = (void*)get_image_data(pe_file, offset, buflen)) != NULL && ((uintptr_t)data % sizeof(uint32_t)) == 0)
+    return data;
+  //read data at position into memory allocated from the arena
+  if ((data = arena_alloc(pe_file, arena, buflen)) == NULL)
+    return NULL;
+  if (read_at(pe_file, offset, data, buflen) < buflen)
+    return NULL;
   return data;
 }
 
-wchar_t* read_len_wstring_at (pefile_handle pe_file, uint32_t offset)
+void* read_data_at (pefile_handle pe_file, uint64_t offset, void* buf, size_t buflen)
+{
+  void* data;
+  //allocate buffer dynamically if NULL pointer was given (using the allocation functions of the handle, the caller releases it with the matching free function)
+  if (!buf) {
+    if ((data = pe_malloc(pe_file, buflen)) == NULL)
+      return NULL;
+  } else {
+    data = buf;
+  }
+  //read data at position
+  if (read_at(pe_file, offset, data, buflen) < buflen) {
+    if (!buf)
+      pe_free(pe_file, data);
+    data = NULL;
+  }
+  return data;
+}
+
+//get length-prefixed wide string at specified position, allocated from the arena
+static wchar_t* read_len_wstring_at (pefile_handle pe_file, struct pefile_arena_struct* arena, uint64_t offset)
 {
-  uint64_t origfilepos;
   wchar_t* data = NULL;
   uint16_t datalen;
-  //remember original file position
-  origfilepos = (pe_file->tell_fn)(pe_file->iohandle);
   //read data at position, starting with string length
-  if ((pe_file->seek_fn)(pe_file->iohandle, offset) == 0 && (pe_file->read_fn)(pe_file->iohandle, &datalen, sizeof(datalen)) == sizeof(datalen)) {
-    if ((data = (wchar_t*)malloc((datalen + 1) * sizeof(wchar_t))) != NULL) {
+  if (read_at(pe_file, offset, &datalen, sizeof(datalen)) == sizeof(datalen)) {
+    if ((data = (wchar_t*)arena_alloc(pe_file, arena, (datalen + 1) * sizeof(wchar_t))) != NULL) {
       //set terminating zero
       data[datalen] = 0;
       //set actual lentgh in bytes
       datalen *= sizeof(wchar_t);
       //read wide string data
-      if ((pe_file->read_fn)(pe_file->iohandle, data, datalen) < datalen) {
-        free(data);
+      if (read_at(pe_file, (uint64_t)offset + sizeof(uint16_t), data, datalen) < datalen) {
         data = NULL;
       }
     }
   }
-  //restore original file position
-  (pe_file->seek_fn)(pe_file->iohandle, origfilepos);
   return data;
 }
 
-int pefile_process_import_section (pefile_handle pe_file, struct peheader_imagesection* section, uint32_t fileposition, uint32_t sectionlength, PEfile_list_imports_fn callbackfn, void* callbackdata)
+//get zero-terminated string preceded by prefixlen bytes of other data at specified position without allocating memory for each string
+//returns pointer to the prefix inside the image data in memory or inside the buffer (valid until the buffer is reused or freed), len is set to the string length
+//the buffer is allocated from the arena specified when initializing it with string_buffer_init()
+static const char* read_prefixed_string_view_at (pefile_handle pe_file, uint64_t offset, size_t prefixlen, struct pefile_string_buffer_struct* strbuf, size_t* len)
+{
+  const char* end;
+  char* newdata;
+  size_t datalen = 0;
+  size_t searchpos;
+  size_t n;
+  //use data in memory directly if string is terminated within the image
+  if (pe_file->imagedata) {
+    if (offset >= pe_file->imagedatalen || pe_file->imagedatalen - offset <= prefixlen || (end = (const char*)memchr(pe_file->imagedata + offset + prefixlen, 0, pe_file->imagedatalen - offset - prefixlen)) == NULL)
+      return NULL;
+    if (len)
+      *len = end - (const char*)(pe_file->imagedata + offset) - prefixlen;
+    return (const char*)(pe_file->imagedata + offset);
+  }
+  //read data in buffer (growing it as needed) until terminating zero is found
+  while (1) {
+    if (strbuf->dataallocated - datalen < READ_STRING_STEP) {
+      if ((newdata = (char*)arena_alloc(pe_file, strbuf->arena, strbuf->dataallocated + READ_STRING_BUFFER_STEP)) == NULL)
+        return NULL;
+      if (datalen)
+        memcpy(newdata, strbuf->data, datalen);
+      strbuf->data = newdata;
+      strbuf->dataallocated += READ_STRING_BUFFER_STEP;
+    }
+    if ((n = read_at(pe_file, offset + datalen, strbuf->data + datalen, strbuf->dataallocated - datalen)) == 0)
+      return NULL;
+    searchpos = (datalen > prefixlen ? datalen : prefixlen);
+    datalen += n;
+    if (datalen > searchpos && (end = (const char*)memchr(strbuf->data + searchpos, 0, datalen - searchpos)) != NULL) {
+      if (len)
+        *len = end - strbuf->data - prefixlen;
+      return strbuf->data;
+    }
+  }
+}
+
+//get zero-terminated string at specified position without allocating memory for each string (see read_prefixed_string_view_at())
+static inline const char* read_string_view_at (pefile_handle pe_file, uint64_t offset, struct pefile_string_buffer_struct* strbuf, size_t* len)
+{
+  return read_prefixed_string_view_at(pe_file, offset, 0, strbuf, len);
+}
+
+//initialize string buffer to allocate from the specified arena
+static inline void string_buffer_init (struct pefile_string_buffer_struct* strbuf, struct pefile_arena_struct* arena)
+{
+  strbuf->data = NULL;
+  strbuf->dataallocated = 0;
+  strbuf->arena = arena;
+}
+
+//compare zero-terminated string at specified position with string without allocating memory, returns <0, 0 or >0 like strcmp() (>0 if not readable)
+static int compare_string_at (pefile_handle pe_file, uint64_t offset, const char* str, size_t len)
+{
+  const uint8_t* data;
+  uint8_t buf[READ_STRING_STEP * 2];
+  uint64_t datalen;
+  size_t pos = 0;
+  size_t i;
+  while (1) {
+    //get remaining data in memory or read next block
+    if (pe_file->imagedata) {
+      if (offset >= pe_file->imagedatalen || pos >= pe_file->imagedatalen - offset)
+        return 1;
+      data = pe_file->imagedata + offset + pos;
+      datalen = pe_file->imagedatalen - offset - pos;
+    } else {
+      if ((datalen = read_at(pe_file, offset + pos, buf, sizeof(buf))) == 0)
+        return 1;
+      data = buf;
+    }
+    for (i = 0; i < datalen; i++, pos++) {
+      if (pos == len)
+        return (data[i] == 0 ? 0 : 1);
+      if (data[i] != (uint8_t)str[pos])
+        return (data[i] < (uint8_t)str[pos] ? -1 : 1);
+    }
+  }
+}
+
+//decode import lookup table entries (PE32 or PE64) to 32-bit values with PE_IMPORT_LOOKUP_BY_ORDINAL set for ordinals, returns number of entries before terminating entry
+static size_t decode_import_lookup_entries (const uint8_t* data, size_t entrycount, int is64bit, uint32_t* values, int* terminated)
+{
+  size_t i;
+  *terminated = 0;
+  for (i = 0; i < entrycount; i++) {
+    if (is64bit) {
+      uint64_t entry;
+      memcpy(&entry, data + i * sizeof(entry), sizeof(entry));
+      if (entry == 0) {
+        *terminated = 1;
+        break;
+      }
+      values[i] = ((entry & 0x8000000000000000) == 0 ? (uint32_t)(entry & 0x000000007FFFFFFF) : (PE_IMPORT_LOOKUP_BY_ORDINAL | (uint32_t)(entry & 0x000000000000FFFF)));
+    } else {
+      uint32_t entry;
+      memcpy(&entry, data + i * sizeof(entry), sizeof(entry));
+      if (entry == 0) {
+        *terminated = 1;
+        break;
+      }
+      values[i] = ((entry & 0x80000000) == 0 ? (entry & 0x7FFFFFFF) : (PE_IMPORT_LOOKUP_BY_ORDINAL | (entry & 0x0000FFFF)));
+    }
+  }
+  return i;
+}
+
+//callback function type used internally for each import, moduleindex is the index of the import directory entry
+typedef int (*pefile_import_entry_fn) (uint32_t moduleindex, const char* modulename, size_t modulenamelen, const char* functionname, size_t functionnamelen, uint16_t hint, uint16_t ordinal, uint32_t iatrva, void* callbackdata);
+
+int pefile_process_import_section (pefile_handle pe_file, uint32_t directoryrva, uint32_t directorylength, pefile_import_entry_fn callbackfn, void* callbackdata)
 {
   //process import directory
   struct peheader_imageimportdirectory imgimpdir;
-  char* modulename;
-  uint32_t importlookupvalue;
-  int importlookupbyname;
+  struct pefile_arena_struct* arena;
+  struct pefile_string_buffer_struct modulenamebuf;
+  struct pefile_string_buffer_struct functionnamebuf;
+  const char* modulename;
+  size_t modulenamelen;
+  const char* functionname;
+  size_t functionnamelen;
+  uint8_t lookupdata[IMPORT_LOOKUP_BLOCK * sizeof(uint64_t)];
+  uint32_t lookupvalues[IMPORT_LOOKUP_BLOCK];
+  size_t lookupcount;
+  size_t i;
   int done;
-  uint64_t oldpos = (pe_file->tell_fn)(pe_file->iohandle);
-  uint32_t pos = fileposition;
+  uint64_t lookuppos;
+  uint32_t iatrva;
+  uint16_t hint;
+  uint32_t moduleindex = 0;
+  uint32_t pos = directoryrva;
+  int is64bit = (pe_file->optionalheader->common.Signature == PE_SIGNATURE_PE64);
+  size_t entrysize = (is64bit ? sizeof(uint64_t) : sizeof(uint32_t));
   int result = 0;
-  //iterate trough import directory
-  while (pos + sizeof(imgimpdir) <= fileposition + sectionlength && read_data_at(pe_file, pos, &imgimpdir, sizeof(imgimpdir)) && !(imgimpdir.ImportLookupTable == 0 && imgimpdir.TimeDateStamp == 0 && imgimpdir.ForwarderChain == 0 && imgimpdir.Name == 0 && imgimpdir.ImportAddressTable == 0)) {
+  //get arena for string buffers (not shared with other threads processing the same file)
+  if ((arena = arena_acquire(pe_file)) == NULL)
+    return PE_RESULT_OUT_OF_MEMORY;
+  string_buffer_init(&modulenamebuf, arena);
+  string_buffer_init(&functionnamebuf, arena);
+  //iterate trough import directory (reporting data that can't be read as an error instead of leaving out imports)
+  while (result == 0 && pos + sizeof(imgimpdir) <= directoryrva + directorylength) {
+    if (!read_data_at(pe_file, rva_to_offset(pe_file, pos), &imgimpdir, sizeof(imgimpdir))) {
+      result = PE_RESULT_READ_ERROR;
+      break;
+    }
+    if (imgimpdir.ImportLookupTable == 0 && imgimpdir.TimeDateStamp == 0 && imgimpdir.ForwarderChain == 0 && imgimpdir.Name == 0 && imgimpdir.ImportAddressTable == 0)
+      break;
     //get module name
-    modulename = read_string_at(pe_file, imgimpdir.Name - section->VirtualAddress + section->PointerToRawData);
-    //position at import lookup table
-    (pe_file->seek_fn)(pe_file->iohandle, imgimpdir.ImportLookupTable - section->VirtualAddress + section->PointerToRawData);
-    importlookupvalue = 0;
-    importlookupbyname = 0;
     done = 0;
-    //iterate through import lookup table
+    modulenamelen = 0;
+    if ((modulename = read_string_view_at(pe_file, rva_to_offset(pe_file, imgimpdir.Name), &modulenamebuf, &modulenamelen)) == NULL) {
+      result = PE_RESULT_READ_ERROR;
+      break;
+    }
+    //position at import lookup table
+    if ((lookuppos = rva_to_offset(pe_file, imgimpdir.ImportLookupTable)) == PE_INVALID_OFFSET)
+      done = 1;
+    iatrva = imgimpdir.ImportAddressTable;
+    //iterate through import lookup table, reading a block of entries at a time
     while (result == 0 && !done) {
-      switch (pe_file->optionalheader->common.Signature) {
-        case PE_SIGNATURE_PE32:
-          {
-            uint32_t importlookupentry;
-            if ((pe_file->read_fn)(pe_file->iohandle, &importlookupentry, sizeof(importlookupentry)) == sizeof(importlookupentry)) {
-              if (importlookupentry == 0) {
-                done++;
-              } else {
-                importlookupbyname = ((importlookupentry & 0x80000000) == 0);
-                importlookupvalue = importlookupentry & (importlookupbyname ? 0x7FFFFFFF : 0x0000FFFF);
-              }
-            }
-          }
-          break;
-        case PE_SIGNATURE_PE64:
-          {
-            uint64_t importlookupentry;
-            if ((pe_file->read_fn)(pe_file->iohandle, &importlookupentry, sizeof(importlookupentry)) == sizeof(importlookupentry)) {
-              if (importlookupentry == 0) {
-                done++;
-              } else {
-                importlookupbyname = ((importlookupentry & 0x8000000000000000) == 0);
-                importlookupvalue = importlookupentry & (importlookupbyname ? 0x000000007FFFFFFF : 0x000000000000FFFF);
-              }
-            }
-          }
-          break;
+      lookupcount = read_at(pe_file, lookuppos, lookupdata, IMPORT_LOOKUP_BLOCK * entrysize) / entrysize;
+      if (lookupcount == 0) {
+        result = PE_RESULT_READ_ERROR;
+        break;
       }
-      if (!done) {
-        if (importlookupbyname) {
-          char* functionname;
-          if ((functionname = read_string_at(pe_file, importlookupvalue + 2 - section->VirtualAddress + section->PointerToRawData)) != NULL) {
-            result = (*callbackfn)(modulename, functionname, callbackdata);
-            free(functionname);
+      lookupcount = decode_import_lookup_entries(lookupdata, lookupcount, is64bit, lookupvalues, &done);
+      lookuppos += lookupcount * entrysize;
+      //process the entries read
+      for (i = 0; result == 0 && i < lookupcount; i++) {
+        if ((lookupvalues[i] & PE_IMPORT_LOOKUP_BY_ORDINAL) == 0) {
+          //hint/name table entry contains 16-bit hint followed by name (read both at once)
+          if ((functionname = read_prefixed_string_view_at(pe_file, rva_to_offset(pe_file, lookupvalues[i]), sizeof(hint), &functionnamebuf, &functionnamelen)) == NULL) {
+            result = PE_RESULT_READ_ERROR;
+          } else {
+            memcpy(&hint, functionname, sizeof(hint));
+            result = (*callbackfn)(moduleindex, modulename, modulenamelen, functionname + sizeof(hint), functionnamelen, hint, 0, iatrva, callbackdata);
           }
         } else {
-          char ordinal[7];
-          snprintf(ordinal, sizeof(ordinal), "@%" PRIu16, (uint16_t)importlookupvalue);
-          result = (*callbackfn)(modulename, ordinal, callbackdata);
+          result = (*callbackfn)(moduleindex, modulename, modulenamelen, NULL, 0, 0, (uint16_t)lookupvalues[i], iatrva, callbackdata);
         }
+        iatrva += entrysize;
       }
     }
 /*
     if (imgimpdir.ForwarderChain)
       printf("ForwarderChain: 0x%08" PRIX32 "\n", imgimpdir.ForwarderChain);/////
 */
-    if (modulename)
-      free(modulename);
     //move to position of next import directory
     pos += sizeof(imgimpdir);
+    moduleindex++;
   }
-  (pe_file->seek_fn)(pe_file->iohandle, oldpos);
+  arena_giveback(pe_file, arena);
   return result;
 }
 
-int pefile_process_export_section (pefile_handle pe_file, struct peheader_imagesection* section, uint32_t fileposition, uint32_t sectionlength, PEfile_list_exports_fn callbackfn, void* callbackdata)
+//check if exported symbol is data (address outside known sections or within non-code section)
+static int is_export_data (pefile_handle pe_file, uint32_t addr)
+{
+  struct peheader_imagesection* s;
+  return ((s = find_section(pe_file, addr)) == NULL || (s->Characteristics & PE_IMGSECTION_TYPE_CODE) == 0);
+}
+
+int pefile_process_export_section (pefile_handle pe_file, uint32_t directoryrva, uint32_t directorylength, PEfile_list_exports_v2_fn callbackfn, void* callbackdata)
 {
   struct peheader_imageexportdirectory imgexpdir;
-  char* modulename;
-  char* functionname;
+  struct pefile_arena_struct* arena;
+  struct pefile_string_buffer_struct modulenamebuf;
+  struct pefile_string_buffer_struct functionnamebuf;
+  struct pefile_string_buffer_struct functionforwardernamebuf;
+  const char* modulename;
+  size_t modulenamelen = 0;
+  const char* functionname;
+  size_t functionnamelen;
   int isdata;
-  char* functionforwardername;
+  const char* functionforwardername;
+  size_t functionforwardernamelen;
   uint32_t i;
   uint32_t* functionaddr;
   uint32_t* functionnamerva;
   uint16_t* functionnameordinal;
-  struct peheader_imagesection* s;
+  uint32_t addr;
   int result = 0;
   //read export directory
-  if (read_data_at(pe_file, fileposition, &imgexpdir, (sectionlength < sizeof(imgexpdir) ? sectionlength : sizeof(imgexpdir))) == NULL)
+  if (directorylength < sizeof(imgexpdir))
+    memset(&imgexpdir, 0, sizeof(imgexpdir));
+  if (read_data_at(pe_file, rva_to_offset(pe_file, directoryrva), &imgexpdir, (directorylength < sizeof(imgexpdir) ? directorylength : sizeof(imgexpdir))) == NULL)
     return 1;
+  //get arena for tables and string buffers (not shared with other threads processing the same file)
+  if ((arena = arena_acquire(pe_file)) == NULL)
+    return PE_RESULT_OUT_OF_MEMORY;
+  string_buffer_init(&modulenamebuf, arena);
+  string_buffer_init(&functionnamebuf, arena);
+  string_buffer_init(&functionforwardernamebuf, arena);
   //process export directory
-  modulename = read_string_at(pe_file, imgexpdir.Name - section->VirtualAddress + section->PointerToRawData);
+  modulename = read_string_view_at(pe_file, rva_to_offset(pe_file, imgexpdir.Name), &modulenamebuf, &modulenamelen);
   //read Export Address Table (EAT)
-  if (imgexpdir.AddressOfFunctions && (functionaddr = read_data_at(pe_file, imgexpdir.AddressOfFunctions - section->VirtualAddress + section->PointerToRawData, NULL, sizeof(uint32_t) * imgexpdir.NumberOfFunctions)) != NULL) {
+  if (imgexpdir.AddressOfFunctions && (functionaddr = read_arena_data_at(pe_file, arena, rva_to_offset(pe_file, imgexpdir.AddressOfFunctions), sizeof(uint32_t) * imgexpdir.NumberOfFunctions)) != NULL) {
     if (imgexpdir.NumberOfNames == 0) {
       for (i = 0; i < imgexpdir.NumberOfFunctions; i++) {
-        isdata = 0;
-        if ((s = find_section(pe_file, functionaddr[i])) == NULL || (s /*&& s != section*/ && (s->Characteristics & PE_IMGSECTION_TYPE_CODE) == 0))
-          isdata = 1;
-        else
-          isdata = 0;
-        result = (*callbackfn)(modulename, NULL, i + imgexpdir.Base, isdata, NULL, callbackdata);
+        isdata = is_export_data(pe_file, functionaddr[i]);
+        result = (*callbackfn)(modulename, modulenamelen, NULL, 0, i + imgexpdir.Base, isdata, NULL, 0, callbackdata);
       }
     } else {
       //read Export Ordinal Table (EOT)
-      functionnameordinal = read_data_at(pe_file, imgexpdir.AddressOfNameOrdinals - section->VirtualAddress + section->PointerToRawData, NULL, sizeof(uint16_t) * imgexpdir.NumberOfNames);
+      functionnameordinal = read_arena_data_at(pe_file, arena, rva_to_offset(pe_file, imgexpdir.AddressOfNameOrdinals), sizeof(uint16_t) * imgexpdir.NumberOfNames);
       //read Export Name Table (ENT)
-      if ((functionnamerva = read_data_at(pe_file, imgexpdir.AddressOfNames - section->VirtualAddress + section->PointerToRawData, NULL, sizeof(uint32_t) * imgexpdir.NumberOfNames)) != NULL) {
+      if ((functionnamerva = read_arena_data_at(pe_file, arena, rva_to_offset(pe_file, imgexpdir.AddressOfNames), sizeof(uint32_t) * imgexpdir.NumberOfNames)) != NULL) {
         for (i = 0; result == 0 && i < imgexpdir.NumberOfNames; i++) {
-          if ((functionname = read_string_at(pe_file, functionnamerva[i] - section->VirtualAddress + section->PointerToRawData)) != NULL) {
-            //forwarded function if address points within export section
-            //if (functionaddr[functionnameordinal[i]] >= section->VirtualAddress && functionaddr[functionnameordinal[i]] < section->VirtualAddress + section->SizeOfRawData)
-            if (functionaddr[functionnameordinal[i]] >= section->VirtualAddress && functionaddr[functionnameordinal[i]] < section->VirtualAddress + sectionlength)
-              functionforwardername = read_string_at(pe_file, functionaddr[functionnameordinal[i]] - section->VirtualAddress + section->PointerToRawData);
+          if ((functionname = read_string_view_at(pe_file, rva_to_offset(pe_file, functionnamerva[i]), &functionnamebuf, &functionnamelen)) != NULL) {
+            addr = (functionnameordinal && functionnameordinal[i] < imgexpdir.NumberOfFunctions ? functionaddr[functionnameordinal[i]] : 0);
+            //forwarded function if address points within export directory
+            functionforwardernamelen = 0;
+            if (addr >= directoryrva && addr - directoryrva < directorylength)
+              functionforwardername = read_string_view_at(pe_file, rva_to_offset(pe_file, addr), &functionforwardernamebuf, &functionforwardernamelen);
             else
               functionforwardername = NULL;
             //data entry if function points outside known sections or within non-code section
-            if ((s = find_section(pe_file, functionaddr[functionnameordinal[i]])) == NULL || (s /*&& s != section*/ && (s->Characteristics & PE_IMGSECTION_TYPE_CODE) == 0))
-              isdata = 1;
-            else
-              isdata = 0;
-            //run callback function, except if function pointer points to current section but outside specified sectionlength
-            if (!(functionaddr[functionnameordinal[i]] >= section->VirtualAddress + sectionlength && functionaddr[functionnameordinal[i]] < section->VirtualAddress + section->SizeOfRawData))
-              result = (*callbackfn)(modulename, functionname, (functionnameordinal && functionnameordinal[i] <= imgexpdir.NumberOfFunctions ? functionnameordinal[i] + imgexpdir.Base : 0), isdata, functionforwardername, callbackdata);
-            if (functionforwardername)
-              free(functionforwardername);
-            free(functionname);
+            isdata = is_export_data(pe_file, addr);
+            //run callback function
+            result = (*callbackfn)(modulename, modulenamelen, functionname, functionnamelen, (functionnameordinal && functionnameordinal[i] <= imgexpdir.NumberOfFunctions ? functionnameordinal[i] + imgexpdir.Base : 0), isdata, functionforwardername, functionforwardernamelen, callbackdata);
           }
         }
-        free(functionnamerva);
       }
-      if (functionnameordinal)
-        free(functionnameordinal);
     }
-    free(functionaddr);
   }
-  free(modulename);
+  arena_giveback(pe_file, arena);
   return result;
 }
 
@@ -317,66 +932,104 @@ DLL_EXPORT_PEDEPS const char* pefile_status_message (int statuscode)
       return "wrong endianness";
     case PE_RESULT_WRONG_IMAGE:
       return "wrong image type";
+    case PE_RESULT_INVALID_RVA:
+      return "invalid relative virtual address";
+    case PE_RESULT_NOT_FOUND:
+      return "not found";
     default:
       return "(unknown status code)";
   }
 }
 
 DLL_EXPORT_PEDEPS pefile_handle pefile_create ()
+{
+  return pefile_create_with_allocator(NULL, NULL, NULL, NULL);
+}
+
+DLL_EXPORT_PEDEPS pefile_handle pefile_create_with_allocator (PEmem_malloc_fn malloc_fn, PEmem_realloc_fn realloc_fn, PEmem_free_fn free_fn, void* userdata)
 {
   pefile_handle pe_file;
-  if ((pe_file = (struct pefile_struct*)malloc(sizeof(struct pefile_struct))) != NULL) {
+  //use global allocation functions if none were specified
+  if (!malloc_fn || !realloc_fn || !free_fn) {
+    malloc_fn = global_malloc_fn;
+    realloc_fn = global_realloc_fn;
+    free_fn = global_free_fn;
+    userdata = global_memuserdata;
+  }
+  if ((pe_file = (struct pefile_struct*)(malloc_fn)(sizeof(struct pefile_struct), userdata)) != NULL) {
+    pe_file->malloc_fn = malloc_fn;
+    pe_file->realloc_fn = realloc_fn;
+    pe_file->free_fn = free_fn;
+    pe_file->memuserdata = userdata;
+    pe_file->pread_fn = NULL;
     pe_file->read_fn = NULL;
     pe_file->tell_fn = NULL;
     pe_file->seek_fn = NULL;
     pe_file->close_fn = NULL;
     pe_file->iohandle = NULL;
+    pe_file->imagedata = NULL;
+    pe_file->imagedatalen = 0;
+    pe_file->imagemapped = 0;
+    pe_file->cacheblocksize = 0;
+    pe_file->cacheblockcount = 0;
+    pe_file->cachedata = NULL;
+    pe_file->cacheblocks = NULL;
+    pe_file->cachetick = 0;
+    pe_file->cachehits = 0;
+    pe_file->cachemisses = 0;
+    pe_mutex_init(&(pe_file->iolock));
+    pe_mutex_init_recursive(&(pe_file->initlock));
+    pe_file->arena.first = NULL;
+    pe_file->arena.current = NULL;
+    pe_file->arena.next = NULL;
+    pe_file->arenapool = NULL;
     pe_file->optionalheader = NULL;
     pe_file->datadir = NULL;
     pe_file->pecommonext = NULL;
+    pe_file->sectiontablepos = 0;
+    pe_file->sectionsloaded = 0;
+    pe_file->sectiondata = NULL;
+    pe_file->sectiondataallocated = 0;
     pe_file->sections = NULL;
+    pe_file->sectionorder = NULL;
+    pe_file->lastsection = 0;
+    pe_file->importtable = NULL;
+    memset(&(pe_file->exportcache), 0, sizeof(pe_file->exportcache));
   }
   return pe_file;
 }
 
-DLL_EXPORT_PEDEPS int pefile_open_custom (pefile_handle pe_file, void* iohandle, PEio_read_fn read_fn, PEio_tell_fn tell_fn, PEio_seek_fn seek_fn, PEio_close_fn close_fn)
+static int pefile_read_headers (pefile_handle pe_file)
 {
-  pe_file->iohandle = iohandle;
-  pe_file->read_fn = read_fn;
-  pe_file->tell_fn = tell_fn;
-  pe_file->seek_fn = seek_fn;
-  pe_file->close_fn = close_fn;
+  uint64_t pos;
+  //discard data cached or allocated for previously opened file
+  cache_invalidate(pe_file);
+  arena_reset(pe_file, &(pe_file->arena));
+  pe_file->importtable = NULL;
   //read DOS header
-  if ((pe_file->seek_fn)(pe_file->iohandle, 0) != 0)
-    return PE_RESULT_SEEK_ERROR;
-  if ((pe_file->read_fn)(pe_file->iohandle, &(pe_file->dosheader), sizeof(struct PEheader_DOS)) != sizeof(struct PEheader_DOS))
+  if (read_at(pe_file, 0, &(pe_file->dosheader), sizeof(struct PEheader_DOS)) != sizeof(struct PEheader_DOS))
     return PE_RESULT_READ_ERROR;
   //check for MZ in the beginning of the file
   if (pe_file->dosheader.e_magic != 0x5A4D)
     return PE_RESULT_NOT_PE;
   //read PE header
-  if ((pe_file->seek_fn)(pe_file->iohandle, pe_file->dosheader.e_lfanew) != 0)
-    return PE_RESULT_SEEK_ERROR;
-  if ((pe_file->read_fn)(pe_file->iohandle, &(pe_file->peheader), sizeof(struct PEheader_PE)) != sizeof(struct PEheader_PE))
+  pos = pe_file->dosheader.e_lfanew;
+  if (read_at(pe_file, pos, &(pe_file->peheader), sizeof(struct PEheader_PE)) != sizeof(struct PEheader_PE))
     return PE_RESULT_READ_ERROR;
+  pos += sizeof(struct PEheader_PE);
   //check for little endian PE signature
   if (pe_file->peheader.signature != 0x00004550)
     return PE_RESULT_NOT_PE_LE;
   //read COFF header
-  if ((pe_file->read_fn)(pe_file->iohandle, &(pe_file->coffheader), sizeof(struct PEheader_COFF)) != sizeof(struct PEheader_COFF))
+  if (read_at(pe_file, pos, &(pe_file->coffheader), sizeof(struct PEheader_COFF)) != sizeof(struct PEheader_COFF))
     return PE_RESULT_READ_ERROR;
+  pos += sizeof(struct PEheader_COFF);
   //read optional header
-  if (pe_file->coffheader.SizeOfOptionalHeader == 0) {
-    pe_file->optionalheader = NULL;
-  } else {
-    if ((pe_file->optionalheader = malloc(pe_file->coffheader.SizeOfOptionalHeader)) == NULL)
-      return PE_RESULT_OUT_OF_MEMORY;
-    if ((pe_file->read_fn)(pe_file->iohandle, pe_file->optionalheader, pe_file->coffheader.SizeOfOptionalHeader) != pe_file->coffheader.SizeOfOptionalHeader) {
-      free(pe_file->optionalheader);
-      pe_file->optionalheader = NULL;
-      return PE_RESULT_READ_ERROR;
-    }
-  }
+  if (pe_file->coffheader.SizeOfOptionalHeader < sizeof(struct PEheader_optional_common))
+    return PE_RESULT_WRONG_IMAGE;
+  if ((pe_file->optionalheader = read_arena_data_at(pe_file, &(pe_file->arena), pos, pe_file->coffheader.SizeOfOptionalHeader)) == NULL)
+    return PE_RESULT_READ_ERROR;
+  pos += pe_file->coffheader.SizeOfOptionalHeader;
   //check image signature (267 for 32 bit Windows, 523 for 64 bit Windows, and 263 for a ROM image)
   switch (pe_file->optionalheader->common.Signature) {
     case PE_SIGNATURE_PE32:
@@ -396,31 +1049,51 @@ DLL_EXPORT_PEDEPS int pefile_open_custom (pefile_handle pe_file, void* iohandle,
       break;
 */
     default:
-      free(pe_file->optionalheader);
       pe_file->optionalheader = NULL;
       return PE_RESULT_WRONG_IMAGE;
   }
-  //read all sections
-  if ((pe_file->sections = malloc(sizeof(struct peheader_imagesection) * pe_file->coffheader.NumberOfSections)) == NULL) {
-    free(pe_file->optionalheader);
-    pe_file->optionalheader = NULL;
-    return PE_RESULT_OUT_OF_MEMORY;
-  }
-  if ((pe_file->read_fn)(pe_file->iohandle, pe_file->sections, sizeof(struct peheader_imagesection) * pe_file->coffheader.NumberOfSections) != sizeof(struct peheader_imagesection) * pe_file->coffheader.NumberOfSections) {
-    free(pe_file->optionalheader);
-    pe_file->optionalheader = NULL;
-    free(pe_file->sections);
-    pe_file->sections = NULL;
-    return PE_RESULT_READ_ERROR;
-  }
+  //remember position of section table (loaded when needed)
+  pe_file->sectiontablepos = pos;
+  pe_file->sectionsloaded = 0;
+  pe_file->sections = NULL;
+  pe_file->sectionorder = NULL;
+  pe_file->lastsection = 0;
   return 0;
 }
 
-uint64_t PEio_fread (void* iohandle, void* buf, uint64_t buflen)
+DLL_EXPORT_PEDEPS int pefile_open_custom (pefile_handle pe_file, void* iohandle, PEio_read_fn read_fn, PEio_tell_fn tell_fn, PEio_seek_fn seek_fn, PEio_close_fn close_fn)
 {
-  if (!iohandle)
-    return 0;
-  return (uint64_t)fread(buf, 1, buflen, (FILE*)iohandle);
+  pe_file->iohandle = iohandle;
+  pe_file->pread_fn = NULL;
+  pe_file->read_fn = read_fn;
+  pe_file->tell_fn = tell_fn;
+  pe_file->seek_fn = seek_fn;
+  pe_file->close_fn = close_fn;
+  pe_file->imagedata = NULL;
+  pe_file->imagedatalen = 0;
+  pe_file->imagemapped = 0;
+  return pefile_read_headers(pe_file);
+}
+
+DLL_EXPORT_PEDEPS int pefile_open_custom_pread (pefile_handle pe_file, void* iohandle, PEio_pread_fn pread_fn, PEio_close_fn close_fn)
+{
+  pe_file->iohandle = iohandle;
+  pe_file->pread_fn = pread_fn;
+  pe_file->read_fn = NULL;
+  pe_file->tell_fn = NULL;
+  pe_file->seek_fn = NULL;
+  pe_file->close_fn = close_fn;
+  pe_file->imagedata = NULL;
+  pe_file->imagedatalen = 0;
+  pe_file->imagemapped = 0;
+  return pefile_read_headers(pe_file);
+}
+
+uint64_t PEio_fread (void* iohandle, void* buf, uint64_t buflen)
+{
+  if (!iohandle)
+    return 0;
+  return (uint64_t)fread(buf, 1, buflen, (FILE*)iohandle);
 }
 
 uint64_t PEio_ftell (void* iohandle)
@@ -446,13 +1119,291 @@ void PEio_fclose (void* iohandle)
   fclose((FILE*)iohandle);
 }
 
+#ifdef _WIN32
+uint64_t PEio_pread (void* iohandle, uint64_t pos, void* buf, uint64_t buflen)
+{
+  OVERLAPPED overlapped;
+  DWORD len;
+  uint64_t total = 0;
+  //reading with an offset in the OVERLAPPED structure doesn't depend on the file position
+  while (total < buflen) {
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.Offset = (DWORD)((pos + total) & 0xFFFFFFFF);
+    overlapped.OffsetHigh = (DWORD)((pos + total) >> 32);
+    if (!ReadFile((HANDLE)iohandle, (char*)buf + total, (DWORD)(buflen - total > 0x40000000 ? 0x40000000 : buflen - total), &len, &overlapped) || len == 0)
+      break;
+    total += len;
+  }
+  return total;
+}
+
+void PEio_close (void* iohandle)
+{
+  CloseHandle((HANDLE)iohandle);
+}
+#else
+uint64_t PEio_pread (void* iohandle, uint64_t pos, void* buf, uint64_t buflen)
+{
+  ssize_t len;
+  uint64_t total = 0;
+  while (total < buflen) {
+    if ((len = pread((int)(intptr_t)iohandle, (char*)buf + total, (size_t)(buflen - total), (off_t)(pos + total))) <= 0)
+      break;
+    total += len;
+  }
+  return total;
+}
+
+void PEio_close (void* iohandle)
+{
+  close((int)(intptr_t)iohandle);
+}
+#endif
+
 DLL_EXPORT_PEDEPS int pefile_open_file (pefile_handle pe_file, const char* filename)
 {
-  FILE* filehandle;
-  if ((filehandle = fopen(filename, "rb")) == NULL) {
+  int result;
+#ifdef _WIN32
+  HANDLE filehandle;
+  if ((filehandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE) {
+    return 1;
+  }
+  if ((result = pefile_open_custom_pread(pe_file, (void*)filehandle, &PEio_pread, &PEio_close)) != 0)
+    pefile_close(pe_file);
+#else
+  int filehandle;
+  if ((filehandle = open(filename, O_RDONLY)) == -1) {
+    return 1;
+  }
+  if ((result = pefile_open_custom_pread(pe_file, (void*)(intptr_t)filehandle, &PEio_pread, &PEio_close)) != 0)
+    pefile_close(pe_file);
+#endif
+  return result;
+}
+
+//get information from PE headers (data points to PE signature)
+static int probe_pe_headers (const uint8_t* data, size_t datalen, struct pefile_probe_info_struct* info)
+{
+  struct PEheader_PE peheader;
+  struct PEheader_COFF coffheader;
+  union {
+    union PEheader_optional hdr;
+    uint8_t data[sizeof(union PEheader_optional) + (PE_DATA_DIR_IDX_COUNT - 1) * sizeof(struct PEheader_data_directory)];
+  } opt;
+  size_t optlen;
+  struct PEheader_data_directory* datadir;
+  size_t datadirpos;
+  uint32_t datadirentries;
+  uint32_t i;
+  //get PE and COFF header
+  if (datalen < sizeof(peheader) + sizeof(coffheader))
+    return PE_RESULT_READ_ERROR;
+  memcpy(&peheader, data, sizeof(peheader));
+  if (peheader.signature != 0x00004550)
+    return PE_RESULT_NOT_PE_LE;
+  memcpy(&coffheader, data + sizeof(peheader), sizeof(coffheader));
+  info->machine = coffheader.Machine;
+  info->characteristics = coffheader.Characteristics;
+  info->isdll = ((coffheader.Characteristics & PE_CHARACTERISTIC_IMAGE_FILE_DLL) != 0 ? 1 : 0);
+  info->sectioncount = coffheader.NumberOfSections;
+  //get optional header (as far as available)
+  data += sizeof(peheader) + sizeof(coffheader);
+  datalen -= sizeof(peheader) + sizeof(coffheader);
+  optlen = coffheader.SizeOfOptionalHeader;
+  if (optlen > datalen)
+    optlen = datalen;
+  if (optlen > sizeof(opt))
+    optlen = sizeof(opt);
+  if (optlen < sizeof(struct PEheader_optional_common))
+    return PE_RESULT_WRONG_IMAGE;
+  memset(&opt, 0, sizeof(opt));
+  memcpy(&opt, data, optlen);
+  info->signature = opt.hdr.common.Signature;
+  switch (opt.hdr.common.Signature) {
+    case PE_SIGNATURE_PE32:
+      info->imagebase = opt.hdr.opt32.ImageBase;
+      info->subsystem = opt.hdr.opt32.commonext.Subsystem;
+      datadirentries = opt.hdr.opt32.NumberOfRvaAndSizes;
+      datadir = opt.hdr.opt32.datadirs;
+      break;
+    case PE_SIGNATURE_PE64:
+      info->imagebase = opt.hdr.opt64.ImageBase;
+      info->subsystem = opt.hdr.opt64.commonext.Subsystem;
+      datadirentries = opt.hdr.opt64.NumberOfRvaAndSizes;
+      datadir = opt.hdr.opt64.datadirs;
+      break;
+    default:
+      return PE_RESULT_WRONG_IMAGE;
+  }
+  //only use data directories within the optional header
+  datadirpos = (size_t)((uint8_t*)datadir - opt.data);
+  if (datadirpos > optlen)
+    datadirentries = 0;
+  else if (datadirentries > (optlen - datadirpos) / sizeof(struct PEheader_data_directory))
+    datadirentries = (uint32_t)((optlen - datadirpos) / sizeof(struct PEheader_data_directory));
+  for (i = 0; i < datadirentries && i < PE_DATA_DIR_IDX_COUNT; i++) {
+    if (datadir[i].VirtualAddress && datadir[i].Size)
+      info->datadirectories |= (1 << i);
+  }
+  return PE_RESULT_SUCCESS;
+}
+
+//get information from the beginning of a PE file in memory (needs to continue at e_lfanew if the PE header is beyond the prefix)
+static int probe_prefix (const uint8_t* data, size_t datalen, struct pefile_probe_info_struct* info, uint32_t* peheaderpos)
+{
+  struct PEheader_DOS dosheader;
+  memset(info, 0, sizeof(struct pefile_probe_info_struct));
+  *peheaderpos = 0;
+  if (datalen < sizeof(dosheader))
+    return PE_RESULT_NOT_PE;
+  memcpy(&dosheader, data, sizeof(dosheader));
+  if (dosheader.e_magic != 0x5A4D)
+    return PE_RESULT_NOT_PE;
+  *peheaderpos = dosheader.e_lfanew;
+  if (dosheader.e_lfanew >= datalen || datalen - dosheader.e_lfanew < sizeof(struct PEheader_PE) + sizeof(struct PEheader_COFF) + sizeof(struct PEheader_optional_common))
+    return PE_RESULT_READ_ERROR;
+  return probe_pe_headers(data + dosheader.e_lfanew, datalen - dosheader.e_lfanew, info);
+}
+
+DLL_EXPORT_PEDEPS int pefile_probe_memory (const void* data, size_t datalen, struct pefile_probe_info_struct* info)
+{
+  uint32_t peheaderpos;
+  return probe_prefix((const uint8_t*)data, datalen, info, &peheaderpos);
+}
+
+//check if the PE headers at peheaderpos extend beyond the data that was read
+static int probe_headers_truncated (const uint8_t* data, size_t datalen, uint32_t peheaderpos)
+{
+  struct PEheader_COFF coffheader;
+  if (peheaderpos >= datalen || datalen - peheaderpos < sizeof(struct PEheader_PE) + sizeof(coffheader))
     return 1;
+  memcpy(&coffheader, data + peheaderpos + sizeof(struct PEheader_PE), sizeof(coffheader));
+  return (datalen - peheaderpos - sizeof(struct PEheader_PE) - sizeof(coffheader) < coffheader.SizeOfOptionalHeader);
+}
+
+DLL_EXPORT_PEDEPS int pefile_probe_file (const char* filename, struct pefile_probe_info_struct* info)
+{
+  uint8_t buf[PROBE_PREFIX_SIZE];
+  size_t buflen;
+  uint32_t peheaderpos;
+  int result;
+#ifdef _WIN32
+  HANDLE filehandle;
+  DWORD len;
+  LARGE_INTEGER pos;
+  if ((filehandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE)
+    return PE_RESULT_OPEN_ERROR;
+  buflen = (ReadFile(filehandle, buf, sizeof(buf), &len, NULL) ? len : 0);
+#else
+  int filehandle;
+  ssize_t len;
+  if ((filehandle = open(filename, O_RDONLY)) == -1)
+    return PE_RESULT_OPEN_ERROR;
+  buflen = ((len = pread(filehandle, buf, sizeof(buf), 0)) > 0 ? (size_t)len : 0);
+#endif
+  //read PE headers separately if they don't fit entirely in the first block
+  if (((result = probe_prefix(buf, buflen, info, &peheaderpos)) == PE_RESULT_READ_ERROR || result == PE_RESULT_SUCCESS) && peheaderpos > 0 && buflen == sizeof(buf) && probe_headers_truncated(buf, buflen, peheaderpos)) {
+#ifdef _WIN32
+    pos.QuadPart = peheaderpos;
+    buflen = (SetFilePointerEx(filehandle, pos, NULL, FILE_BEGIN) && ReadFile(filehandle, buf, sizeof(buf), &len, NULL) ? len : 0);
+#else
+    buflen = ((len = pread(filehandle, buf, sizeof(buf), peheaderpos)) > 0 ? (size_t)len : 0);
+#endif
+    memset(info, 0, sizeof(struct pefile_probe_info_struct));
+    result = probe_pe_headers(buf, buflen, info);
+  }
+#ifdef _WIN32
+  CloseHandle(filehandle);
+#else
+  close(filehandle);
+#endif
+  return result;
+}
+
+DLL_EXPORT_PEDEPS int pefile_open_mmap (pefile_handle pe_file, const char* filename)
+{
+  void* data;
+  uint64_t datalen;
+  int result;
+#ifdef _WIN32
+  HANDLE filehandle;
+  HANDLE maphandle;
+  LARGE_INTEGER filesize;
+  if ((filehandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE)
+    return PE_RESULT_OPEN_ERROR;
+  if (!GetFileSizeEx(filehandle, &filesize) || filesize.QuadPart == 0 || (uint64_t)filesize.QuadPart > SIZE_MAX) {
+    CloseHandle(filehandle);
+    return PE_RESULT_READ_ERROR;
+  }
+  datalen = (uint64_t)filesize.QuadPart;
+  maphandle = CreateFileMappingA(filehandle, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(filehandle);
+  if (!maphandle)
+    return PE_RESULT_READ_ERROR;
+  data = MapViewOfFile(maphandle, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(maphandle);
+  if (!data)
+    return PE_RESULT_READ_ERROR;
+#else
+  int filehandle;
+  struct stat filestat;
+  if ((filehandle = open(filename, O_RDONLY)) == -1)
+    return PE_RESULT_OPEN_ERROR;
+  if (fstat(filehandle, &filestat) != 0 || filestat.st_size <= 0 || (uint64_t)filestat.st_size > SIZE_MAX) {
+    close(filehandle);
+    return PE_RESULT_READ_ERROR;
   }
-  return pefile_open_custom(pe_file, filehandle, &PEio_fread, &PEio_ftell, &PEio_fseek, &PEio_fclose);
+  datalen = (uint64_t)filestat.st_size;
+  data = mmap(NULL, (size_t)datalen, PROT_READ, MAP_PRIVATE, filehandle, 0);
+  close(filehandle);
+  if (data == MAP_FAILED)
+    return PE_RESULT_READ_ERROR;
+#endif
+  pe_file->iohandle = NULL;
+  pe_file->pread_fn = NULL;
+  pe_file->read_fn = NULL;
+  pe_file->tell_fn = NULL;
+  pe_file->seek_fn = NULL;
+  pe_file->close_fn = NULL;
+  pe_file->imagedata = (const uint8_t*)data;
+  pe_file->imagedatalen = datalen;
+  pe_file->imagemapped = 1;
+  if ((result = pefile_read_headers(pe_file)) != 0)
+    pefile_close(pe_file);
+  return result;
+}
+
+DLL_EXPORT_PEDEPS int pefile_open_memory (pefile_handle pe_file, const void* data, size_t datalen)
+{
+  int result;
+  if (!data || datalen == 0)
+    return PE_RESULT_READ_ERROR;
+  pe_file->iohandle = NULL;
+  pe_file->pread_fn = NULL;
+  pe_file->read_fn = NULL;
+  pe_file->tell_fn = NULL;
+  pe_file->seek_fn = NULL;
+  pe_file->close_fn = NULL;
+  pe_file->imagedata = (const uint8_t*)data;
+  pe_file->imagedatalen = datalen;
+  pe_file->imagemapped = 0;
+  if ((result = pefile_read_headers(pe_file)) != 0)
+    pefile_close(pe_file);
+  return result;
+}
+
+//free export directory data loaded for looking up exported symbols
+static void export_cache_free (pefile_handle pe_file)
+{
+  pe_free(pe_file, pe_file->exportcache.data);
+  pe_file->exportcache.data = NULL;
+  pe_file->exportcache.directorydata = NULL;
+  pe_file->exportcache.functionaddr = NULL;
+  pe_file->exportcache.functionnamerva = NULL;
+  pe_file->exportcache.functionnameordinal = NULL;
+  pe_file->exportcache.functioncount = 0;
+  pe_file->exportcache.namecount = 0;
+  pe_file->exportcache.loaded = 0;
 }
 
 DLL_EXPORT_PEDEPS void pefile_close (pefile_handle pe_file)
@@ -460,58 +1411,126 @@ DLL_EXPORT_PEDEPS void pefile_close (pefile_handle pe_file)
   if (pe_file->close_fn) {
     (pe_file->close_fn)(pe_file->iohandle);
   }
+  pe_file->pread_fn = NULL;
   pe_file->read_fn = NULL;
   pe_file->tell_fn = NULL;
   pe_file->seek_fn = NULL;
   pe_file->close_fn = NULL;
   pe_file->iohandle = NULL;
-  if (pe_file->optionalheader) {
-    free(pe_file->optionalheader);
-    pe_file->optionalheader = NULL;
-  }
+  pe_file->optionalheader = NULL;
   pe_file->datadir = NULL;
   pe_file->pecommonext = NULL;
-  if (pe_file->sections) {
-    free(pe_file->sections);
-    pe_file->sections = NULL;
+  pe_file->sectiontablepos = 0;
+  pe_file->sectionsloaded = 0;
+  pe_file->sections = NULL;
+  pe_file->sectionorder = NULL;
+  pe_file->lastsection = 0;
+  pe_file->importtable = NULL;
+  export_cache_free(pe_file);
+  if (pe_file->imagemapped) {
+#ifdef _WIN32
+    UnmapViewOfFile((LPCVOID)pe_file->imagedata);
+#else
+    munmap((void*)pe_file->imagedata, (size_t)pe_file->imagedatalen);
+#endif
   }
+  pe_file->imagedata = NULL;
+  pe_file->imagedatalen = 0;
+  pe_file->imagemapped = 0;
+  cache_invalidate(pe_file);
+  arena_reset(pe_file, &(pe_file->arena));
 }
 
 DLL_EXPORT_PEDEPS void pefile_destroy (pefile_handle pe_file)
 {
+  struct pefile_arena_struct* arena;
   pefile_close(pe_file);
-  free(pe_file);
+  pe_free(pe_file, pe_file->cachedata);
+  pe_free(pe_file, pe_file->cacheblocks);
+  pe_free(pe_file, pe_file->sectiondata);
+  arena_free(pe_file, &(pe_file->arena));
+  while ((arena = pe_file->arenapool) != NULL) {
+    pe_file->arenapool = arena->next;
+    arena_free(pe_file, arena);
+    pe_free(pe_file, arena);
+  }
+  pe_mutex_destroy(&(pe_file->iolock));
+  pe_mutex_destroy(&(pe_file->initlock));
+  pe_free(pe_file, pe_file);
+}
+
+DLL_EXPORT_PEDEPS int pefile_set_cache (pefile_handle pe_file, size_t blocksize, size_t blockcount)
+{
+  uint8_t* cachedata = NULL;
+  struct pefile_cache_block_struct* cacheblocks = NULL;
+  if (blocksize == 0 || blockcount == 0) {
+    blocksize = 0;
+    blockcount = 0;
+  } else {
+    if (blockcount > SIZE_MAX / blocksize)
+      return PE_RESULT_OUT_OF_MEMORY;
+    if ((cachedata = (uint8_t*)pe_malloc(pe_file, blocksize * blockcount)) == NULL)
+      return PE_RESULT_OUT_OF_MEMORY;
+    if ((cacheblocks = (struct pefile_cache_block_struct*)pe_malloc(pe_file, sizeof(struct pefile_cache_block_struct) * blockcount)) == NULL) {
+      pe_free(pe_file, cachedata);
+      return PE_RESULT_OUT_OF_MEMORY;
+    }
+  }
+  pe_free(pe_file, pe_file->cachedata);
+  pe_free(pe_file, pe_file->cacheblocks);
+  pe_file->cacheblocksize = blocksize;
+  pe_file->cacheblockcount = blockcount;
+  pe_file->cachedata = cachedata;
+  pe_file->cacheblocks = cacheblocks;
+  pe_file->cachetick = 0;
+  pe_file->cachehits = 0;
+  pe_file->cachemisses = 0;
+  cache_invalidate(pe_file);
+  return PE_RESULT_SUCCESS;
+}
+
+DLL_EXPORT_PEDEPS void pefile_get_cache_stats (pefile_handle pe_file, uint64_t* hits, uint64_t* misses)
+{
+  pe_mutex_lock(&(pe_file->iolock));
+  if (hits)
+    *hits = pe_file->cachehits;
+  if (misses)
+    *misses = pe_file->cachemisses;
+  pe_mutex_unlock(&(pe_file->iolock));
 }
 
 DLL_EXPORT_PEDEPS uint64_t pefile_read (pefile_handle pe_file, uint64_t filepos, uint64_t datalen, void* buf, size_t buflen, pefile_readdata_fn callbackfn, void* callbackdata)
 {
-  uint64_t origfilepos;
   uint64_t dataread = 0;
-  void* localbuffer = NULL;
+  struct pefile_arena_struct* arena = NULL;
+  //pass data in memory directly if no buffer was provided
+  if (buf == NULL && pe_file->imagedata) {
+    if (filepos >= pe_file->imagedatalen)
+      return 0;
+    if (datalen > pe_file->imagedatalen - filepos)
+      datalen = pe_file->imagedatalen - filepos;
+    if (datalen > 0)
+      callbackfn((void*)(pe_file->imagedata + filepos), datalen, callbackdata);
+    return datalen;
+  }
   //check if a buffer is provided or one should be allocated
   if (buf == NULL) {
     if (buflen == 0)
       buflen = 256;
-    if ((localbuffer = malloc(buflen)) == NULL)
+    if ((arena = arena_acquire(pe_file)) == NULL || (buf = arena_alloc(pe_file, arena, buflen)) == NULL) {
+      arena_giveback(pe_file, arena);
       return 0;
-    buf = localbuffer;
+    }
   } else if (buflen == 0) {
     return 0;
   }
-  //remember original file position
-  origfilepos = (pe_file->tell_fn)(pe_file->iohandle);
   //read data at position
-  if ((pe_file->seek_fn)(pe_file->iohandle, filepos) == 0) {
-    while ((buflen = (pe_file->read_fn)(pe_file->iohandle, buf, (dataread + buflen <= datalen ? buflen : datalen - dataread))) > 0) {
-      dataread += buflen;
-      if (callbackfn(buf, buflen, callbackdata) != 0)
-        break;
-    }
+  while ((buflen = read_at(pe_file, filepos + dataread, buf, (dataread + buflen <= datalen ? buflen : datalen - dataread))) > 0) {
+    dataread += buflen;
+    if (callbackfn(buf, buflen, callbackdata) != 0)
+      break;
   }
-  //restore original file position
-  (pe_file->seek_fn)(pe_file->iohandle, origfilepos);
-  if (localbuffer)
-    free(localbuffer);
+  arena_giveback(pe_file, arena);
   return dataread;
 }
 
@@ -557,7 +1576,7 @@ DLL_EXPORT_PEDEPS int pefile_is_dll (pefile_handle pe_file)
   return (pe_file && ((pe_file->coffheader.Characteristics & PE_CHARACTERISTIC_IMAGE_FILE_DLL) != 0) ? 1 : 0);
 }
 
-typedef int (*pefile_iterate_section_fn) (pefile_handle pe_file, struct peheader_imagesection* section, uint32_t fileposition, uint32_t sectionlength, void* callbackfn, void* callbackdata);
+typedef int (*pefile_iterate_section_fn) (pefile_handle pe_file, uint32_t directoryrva, uint32_t directorylength, void* callbackfn, void* callbackdata);
 
 int pefile_iterate_sections (pefile_handle pe_file, int sectionindex, const char* sectionname, size_t maxsectionsize, pefile_iterate_section_fn iteratefn, void* callbackfn, void* callbackdata)
 {
@@ -574,13 +1593,11 @@ int pefile_iterate_sections (pefile_handle pe_file, int sectionindex, const char
   }
 
   //process directory specified in data directory
-  uint32_t processeddir = 0;
+  struct peheader_imagesection* processedsection = NULL;
   if (sectionindex != -1) {
     if (sectionindex < datadirentries && pe_file->datadir[sectionindex].VirtualAddress) {
-      struct peheader_imagesection* rvasection;
-      if ((rvasection = find_section(pe_file, pe_file->datadir[sectionindex].VirtualAddress)) != NULL) {
-        iteratefn(pe_file, rvasection, pe_file->datadir[sectionindex].VirtualAddress - rvasection->VirtualAddress + rvasection->PointerToRawData, pe_file->datadir[PE_DATA_DIR_IDX_IMPORT].Size, callbackfn, callbackdata);
-        processeddir = pe_file->datadir[sectionindex].VirtualAddress - rvasection->VirtualAddress + rvasection->PointerToRawData;
+      if ((processedsection = find_section(pe_file, pe_file->datadir[sectionindex].VirtualAddress)) != NULL) {
+        iteratefn(pe_file, pe_file->datadir[sectionindex].VirtualAddress, pe_file->datadir[sectionindex].Size, callbackfn, callbackdata);
       }
     }
   }
@@ -589,13 +1606,15 @@ int pefile_iterate_sections (pefile_handle pe_file, int sectionindex, const char
   if (sectionname) {
     uint16_t currentsection;
     struct peheader_imagesection* section;
+    if (load_sections(pe_file) != 0)
+      return PE_RESULT_READ_ERROR;
     for (currentsection = 0; currentsection < pe_file->coffheader.NumberOfSections; currentsection++) {
       section = &(pe_file->sections[currentsection]);
       /////TO DO: handle case where name is longer than 8 characters (in which case name is slash followed by decimal value of offset)
       if (section->PointerToRawData && section->SizeOfRawData >= maxsectionsize && memcmp(section->Name, sectionname, 8) == 0) {
         //process directory
-        if (section->PointerToRawData != processeddir && section->SizeOfRawData >= maxsectionsize) {
-          iteratefn(pe_file, section, section->PointerToRawData, section->SizeOfRawData, callbackfn, callbackdata);
+        if (section != processedsection && section->SizeOfRawData >= maxsectionsize) {
+          iteratefn(pe_file, section->VirtualAddress, section->SizeOfRawData, callbackfn, callbackdata);
         }
       }
     }
@@ -605,7 +1624,7 @@ int pefile_iterate_sections (pefile_handle pe_file, int sectionindex, const char
 
 const char debug_section_name[8] = {'.', 'd', 'e', 'b', 'u', 'g', 0, 0};
 
-int process_debug_section (pefile_handle pe_file, struct peheader_imagesection* section, uint32_t fileposition, uint32_t sectionlength, void* callbackfn, void* callbackdata)
+int process_debug_section (pefile_handle pe_file, uint32_t directoryrva, uint32_t directorylength, void* callbackfn, void* callbackdata)
 {
   ++*(unsigned int*)callbackdata;
   return 0;
@@ -641,13 +1660,18 @@ DLL_EXPORT_PEDEPS uint64_t pefile_get_image_base_address (pefile_handle pe_file)
   }
 }
 
-const char import_section_name[8] = {'.', 'i', 'd', 'a', 't', 'a', 0, 0};
+DLL_EXPORT_PEDEPS int pefile_rva_to_offset (pefile_handle pe_file, uint32_t rva, uint64_t* offset)
+{
+  uint64_t pos;
+  if ((pos = rva_to_offset(pe_file, rva)) == PE_INVALID_OFFSET)
+    return PE_RESULT_INVALID_RVA;
+  if (offset)
+    *offset = pos;
+  return PE_RESULT_SUCCESS;
+}
 
-DLL_EXPORT_PEDEPS int pefile_list_imports (pefile_handle pe_file, PEfile_list_imports_fn callbackfn, void* callbackdata)
+static int pefile_list_import_entries (pefile_handle pe_file, pefile_import_entry_fn callbackfn, void* callbackdata)
 {
-/*
-  return pefile_iterate_sections (pe_file, PE_DATA_DIR_IDX_IMPORT, import_section_name, sizeof(struct peheader_imageimportdirectory), (pefile_iterate_section_fn)pefile_process_import_section, callbackfn, callbackdata);
-*/
   uint32_t datadirentries = 0;
   switch (pe_file->optionalheader->common.Signature) {
     case PE_SIGNATURE_PE32:
@@ -659,120 +1683,1665 @@ DLL_EXPORT_PEDEPS int pefile_list_imports (pefile_handle pe_file, PEfile_list_im
     default:
       return PE_RESULT_WRONG_IMAGE;
   }
-
+  if (load_sections(pe_file) != 0)
+    return PE_RESULT_READ_ERROR;
   //process import directory specified in data directory
-  uint32_t processedimpdir = 0;
-  {
-    if (PE_DATA_DIR_IDX_IMPORT < datadirentries && pe_file->datadir[PE_DATA_DIR_IDX_IMPORT].VirtualAddress) {
-      struct peheader_imagesection* rvasection;
-      if ((rvasection = find_section(pe_file, pe_file->datadir[PE_DATA_DIR_IDX_IMPORT].VirtualAddress)) != NULL) {
-        pefile_process_import_section(pe_file, rvasection, pe_file->datadir[PE_DATA_DIR_IDX_IMPORT].VirtualAddress - rvasection->VirtualAddress + rvasection->PointerToRawData, pe_file->datadir[PE_DATA_DIR_IDX_IMPORT].Size, callbackfn, callbackdata);
-        processedimpdir = rvasection->PointerToRawData;
-      }
-    }
-  }
+  if (PE_DATA_DIR_IDX_IMPORT >= datadirentries || !pe_file->datadir[PE_DATA_DIR_IDX_IMPORT].VirtualAddress || !find_section(pe_file, pe_file->datadir[PE_DATA_DIR_IDX_IMPORT].VirtualAddress))
+    return PE_RESULT_SUCCESS;
+  return pefile_process_import_section(pe_file, pe_file->datadir[PE_DATA_DIR_IDX_IMPORT].VirtualAddress, pe_file->datadir[PE_DATA_DIR_IDX_IMPORT].Size, callbackfn, callbackdata);
+}
 
-  //process each section
-  uint16_t currentsection;
-  struct peheader_imagesection* section;
-  for (currentsection = 0; currentsection < pe_file->coffheader.NumberOfSections; currentsection++) {
-    section = &(pe_file->sections[currentsection]);
-    if (section->PointerToRawData && section->SizeOfRawData >= sizeof(struct peheader_imageimportdirectory) && memcmp(section->Name, import_section_name, 8) == 0) {
-      if (section->PointerToRawData != processedimpdir && section->SizeOfRawData >= sizeof(struct peheader_imageimportdirectory)) {
-/////TO DO: test this scenario (additional .idata sections)
-/////TO DO: correct addressing
-/*
-        if (pefile_process_import_section(pe_file, section, section->PointerToRawData, section->SizeOfRawData, callbackfn, callbackdata) != 0)
-          break;
-*/
-      }
-    }
-  }
+struct pefile_list_imports_v2_callback_struct {
+  PEfile_list_imports_v2_fn callbackfn;
+  void* callbackdata;
+};
+
+static int pefile_list_imports_v2_callback (uint32_t moduleindex, const char* modulename, size_t modulenamelen, const char* functionname, size_t functionnamelen, uint16_t hint, uint16_t ordinal, uint32_t iatrva, void* callbackdata)
+{
+  struct pefile_list_imports_v2_callback_struct* data = (struct pefile_list_imports_v2_callback_struct*)callbackdata;
+  return (data->callbackfn)(modulename, modulenamelen, functionname, functionnamelen, ordinal, data->callbackdata);
+}
+
+DLL_EXPORT_PEDEPS int pefile_list_imports_v2 (pefile_handle pe_file, PEfile_list_imports_v2_fn callbackfn, void* callbackdata)
+{
+  struct pefile_list_imports_v2_callback_struct data;
+  data.callbackfn = callbackfn;
+  data.callbackdata = callbackdata;
+  return pefile_list_import_entries(pe_file, pefile_list_imports_v2_callback, &data);
+}
+
+struct pefile_get_imports_struct {
+  pefile_handle pe_file;
+  struct pefile_import_module_struct* modules;
+  size_t modulecount;
+  size_t modulesallocated;
+  struct pefile_import_struct* imports;
+  size_t importcount;
+  size_t importsallocated;
+  char* strings;
+  size_t stringslen;
+  size_t stringsallocated;
+  uint32_t lastmoduleindex;
+  int error;
+};
+
+//make sure a temporary array allocated with the allocation functions of the handle has space for the needed number of elements
+static int grow_array (pefile_handle pe_file, void** data, size_t* allocated, size_t needed, size_t elementsize)
+{
+  size_t newallocated;
+  void* newdata;
+  if (needed <= *allocated)
+    return 0;
+  newallocated = (*allocated ? *allocated : 64);
+  while (newallocated < needed)
+    newallocated *= 2;
+  if (newallocated > UINT32_MAX || (newdata = pe_realloc(pe_file, *data, newallocated * elementsize)) == NULL)
+    return -1;
+  *data = newdata;
+  *allocated = newallocated;
   return 0;
 }
 
-const char export_section_name[8] = {'.', 'e', 'd', 'a', 't', 'a', 0, 0};
+//add zero-terminated string to string pool and return its offset (or UINT32_MAX on error)
+static uint32_t add_import_string (struct pefile_get_imports_struct* data, const char* str, size_t len)
+{
+  uint32_t offset = (uint32_t)data->stringslen;
+  if (grow_array(data->pe_file, (void**)&data->strings, &data->stringsallocated, data->stringslen + len + 1, 1) != 0)
+    return UINT32_MAX;
+  memcpy(data->strings + data->stringslen, str, len);
+  data->strings[data->stringslen + len] = 0;
+  data->stringslen += len + 1;
+  return offset;
+}
 
-DLL_EXPORT_PEDEPS int pefile_list_exports (pefile_handle pe_file, PEfile_list_exports_fn callbackfn, void* callbackdata)
+static int pefile_get_imports_callback (uint32_t moduleindex, const char* modulename, size_t modulenamelen, const char* functionname, size_t functionnamelen, uint16_t hint, uint16_t ordinal, uint32_t iatrva, void* callbackdata)
 {
-  return pefile_iterate_sections (pe_file, PE_DATA_DIR_IDX_EXPORT, export_section_name, sizeof(struct peheader_imageexportdirectory), (pefile_iterate_section_fn)pefile_process_export_section, callbackfn, callbackdata);
+  struct pefile_get_imports_struct* data = (struct pefile_get_imports_struct*)callbackdata;
+  struct pefile_import_module_struct* module;
+  struct pefile_import_struct* entry;
+  //add module when moving to next import directory entry
+  if (data->modulecount == 0 || moduleindex != data->lastmoduleindex) {
+    if (grow_array(data->pe_file, (void**)&data->modules, &data->modulesallocated, data->modulecount + 1, sizeof(struct pefile_import_module_struct)) != 0) {
+      data->error = PE_RESULT_OUT_OF_MEMORY;
+      return 1;
+    }
+    module = &(data->modules[data->modulecount++]);
+    if (!modulename)
+      modulenamelen = 0;
+    if ((module->name = add_import_string(data, (modulename ? modulename : ""), modulenamelen)) == UINT32_MAX) {
+      data->error = PE_RESULT_OUT_OF_MEMORY;
+      return 1;
+    }
+    module->namelen = (uint32_t)modulenamelen;
+    module->firstimport = (uint32_t)data->importcount;
+    module->importcount = 0;
+    data->lastmoduleindex = moduleindex;
+  }
+  //add import record
+  if (grow_array(data->pe_file, (void**)&data->imports, &data->importsallocated, data->importcount + 1, sizeof(struct pefile_import_struct)) != 0) {
+    data->error = PE_RESULT_OUT_OF_MEMORY;
+    return 1;
+  }
+  entry = &(data->imports[data->importcount]);
+  entry->module = (uint32_t)(data->modulecount - 1);
+  entry->iatrva = iatrva;
+  entry->hint = hint;
+  entry->ordinal = ordinal;
+  if (functionname) {
+    entry->byordinal = 0;
+    entry->namelen = (uint32_t)functionnamelen;
+    if ((entry->name = add_import_string(data, functionname, functionnamelen)) == UINT32_MAX) {
+      data->error = PE_RESULT_OUT_OF_MEMORY;
+      return 1;
+    }
+  } else {
+    //offset 0 is an empty string
+    entry->byordinal = 1;
+    entry->namelen = 0;
+    entry->name = 0;
+  }
+  data->importcount++;
+  data->modules[data->modulecount - 1].importcount++;
+  return 0;
 }
 
-const char resource_section_name[8] = {'.', 'r', 's', 'r', 'c', 0, 0, 0};
+#define ALIGN_SIZE(n) (((n) + sizeof(uint64_t) - 1) & ~(size_t)(sizeof(uint64_t) - 1))
 
-int pefile_process_resource_directory (pefile_handle pe_file, struct peheader_imagesection* section, uint32_t startfileposition, uint32_t fileposition, PEfile_list_resourcegroups_fn groupcallbackfn, PEfile_list_resources_fn entrycallbackfn, void* callbackdata, unsigned int level, struct pefile_resource_directory_struct* parentinfo)
+DLL_EXPORT_PEDEPS int pefile_get_imports (pefile_handle pe_file, const struct pefile_imports_struct** imports)
 {
-  uint32_t i;
-  struct peheader_imageresourcedirectory imgresdir;
-  struct peheader_imageresourcedirectory_entry* resentries;
-  struct peheader_imageresourcedirectory_entry* resentry;
-  int cbresult = PE_CB_RETURN_CONTINUE;
-  int abort = 0;
-  //read resource directory
-  if (read_data_at(pe_file, fileposition, &imgresdir, sizeof(imgresdir)) == NULL)
-    return PE_CB_RETURN_ERROR;
-  //read resource entries
-  if ((resentries = read_data_at(pe_file, fileposition + sizeof(imgresdir), NULL, (imgresdir.NumberOfNamedEntries + imgresdir.NumberOfIdEntries) * sizeof(struct peheader_imageresourcedirectory_entry))) == NULL)
-    return PE_CB_RETURN_ERROR;
-  resentry = resentries;
-  //read resource entries
-  for (i = 0; !abort && i < imgresdir.NumberOfNamedEntries + imgresdir.NumberOfIdEntries; i++) {
-    if ((resentry->OffsetToData & PE_RESOURCE_ENTRY_DIR_MASK) != 0) {
-      //resource entry is a directory
-      struct pefile_resource_directory_struct info;
-      info.parent = parentinfo;
-      info.name = NULL;
-      if ((info.isnamed = ((resentry->Name & PE_RESOURCE_ENTRY_NAME_MASK) != 0 ? 1 : 0)) != 0) {
-        //named entry
-        info.id = 0;
-        info.name = read_len_wstring_at(pe_file, startfileposition + (resentry->Name & ~PE_RESOURCE_ENTRY_NAME_MASK));
-      } else {
-        //entry identified by ID
-        info.id = resentry->Name;
-      }
-      if (!parentinfo && groupcallbackfn)
-        cbresult = groupcallbackfn(&info, callbackdata);
-      if (cbresult == PE_CB_RETURN_CONTINUE || cbresult == PE_CB_RETURN_LAST)
-        cbresult = pefile_process_resource_directory(pe_file, section, startfileposition, startfileposition + (resentry->OffsetToData & ~PE_RESOURCE_ENTRY_DIR_MASK), groupcallbackfn, entrycallbackfn, callbackdata, level + 1, &info);
-      else if (cbresult != PE_CB_RETURN_SKIP)
-        abort = 1;
-      if (info.name)
-        free(info.name);
-      if (cbresult == PE_CB_RETURN_LAST || cbresult == PE_CB_RETURN_ABORT)
-        break;
+  struct pefile_get_imports_struct data;
+  struct pefile_imports_struct* table;
+  size_t modulesoffset;
+  size_t importsoffset;
+  size_t stringsoffset;
+  int result;
+  //return table built before
+  if ((table = pe_atomic_load(&(pe_file->importtable))) != NULL) {
+    *imports = table;
+    return PE_RESULT_SUCCESS;
+  }
+  //only one thread builds the table, others wait until it's done
+  pe_mutex_lock(&(pe_file->initlock));
+  if ((table = pe_file->importtable) != NULL) {
+    pe_mutex_unlock(&(pe_file->initlock));
+    *imports = table;
+    return PE_RESULT_SUCCESS;
+  }
+  //collect imports in temporary arrays, starting the string pool with an empty string
+  data.pe_file = pe_file;
+  data.modules = NULL;
+  data.modulecount = 0;
+  data.modulesallocated = 0;
+  data.imports = NULL;
+  data.importcount = 0;
+  data.importsallocated = 0;
+  data.strings = NULL;
+  data.stringslen = 0;
+  data.stringsallocated = 0;
+  data.lastmoduleindex = 0;
+  data.error = PE_RESULT_SUCCESS;
+  if (add_import_string(&data, "", 0) == UINT32_MAX)
+    result = PE_RESULT_OUT_OF_MEMORY;
+  else if ((result = pefile_list_import_entries(pe_file, pefile_get_imports_callback, &data)) != PE_RESULT_SUCCESS && data.error != PE_RESULT_SUCCESS)
+    result = data.error;
+  //copy everything into a single block allocated from the arena of the handle
+  if (result == PE_RESULT_SUCCESS) {
+    modulesoffset = ALIGN_SIZE(sizeof(struct pefile_imports_struct));
+    importsoffset = modulesoffset + ALIGN_SIZE(data.modulecount * sizeof(struct pefile_import_module_struct));
+    stringsoffset = importsoffset + ALIGN_SIZE(data.importcount * sizeof(struct pefile_import_struct));
+    if ((table = (struct pefile_imports_struct*)arena_alloc(pe_file, &(pe_file->arena), stringsoffset + data.stringslen)) == NULL) {
+      result = PE_RESULT_OUT_OF_MEMORY;
     } else {
-      //resource entry is data
-      struct peheader_imageresource_data_entry resdata;
-      if (read_data_at(pe_file, startfileposition + resentry->OffsetToData, &resdata, sizeof(resdata))) {
-        cbresult = entrycallbackfn(pe_file, parentinfo, resdata.OffsetToData - section->VirtualAddress + section->PointerToRawData, resdata.Size, resdata.CodePage, callbackdata);
-        if (cbresult == PE_CB_RETURN_ABORT)
-          abort = 1;
-      }
+      table->modulecount = (uint32_t)data.modulecount;
+      table->importcount = (uint32_t)data.importcount;
+      table->modules = (struct pefile_import_module_struct*)((uint8_t*)table + modulesoffset);
+      table->imports = (struct pefile_import_struct*)((uint8_t*)table + importsoffset);
+      table->strings = (char*)table + stringsoffset;
+      table->stringslen = data.stringslen;
+      if (data.modulecount)
+        memcpy((void*)table->modules, data.modules, data.modulecount * sizeof(struct pefile_import_module_struct));
+      if (data.importcount)
+        memcpy((void*)table->imports, data.imports, data.importcount * sizeof(struct pefile_import_struct));
+      memcpy((void*)table->strings, data.strings, data.stringslen);
+      pe_atomic_store(&(pe_file->importtable), table);
+      *imports = table;
     }
-    resentry++;
   }
+  pe_mutex_unlock(&(pe_file->initlock));
   //clean up
-  free(resentries);
-  return (abort ? PE_CB_RETURN_ABORT : PE_CB_RETURN_ABORT);
+  pe_free(pe_file, data.modules);
+  pe_free(pe_file, data.imports);
+  pe_free(pe_file, data.strings);
+  return result;
 }
 
-struct pefile_list_resources_callback_struct {
-  PEfile_list_resourcegroups_fn groupcallbackfn;
-  PEfile_list_resources_fn entrycallbackfn;
+struct pefile_list_imports_callback_struct {
+  PEfile_list_imports_fn callbackfn;
   void* callbackdata;
 };
 
-int pefile_process_resource_section (pefile_handle pe_file, struct peheader_imagesection* section, uint32_t fileposition, uint32_t sectionlength, PEfile_list_resources_fn callbackfn, void* callbackdata)
+static int pefile_list_imports_callback (const char* modulename, size_t modulenamelen, const char* functionname, size_t functionnamelen, uint16_t ordinal, void* callbackdata)
 {
-  struct pefile_list_resources_callback_struct* data = (struct pefile_list_resources_callback_struct*)callbackdata;
-  return pefile_process_resource_directory(pe_file, section, fileposition, fileposition, data->groupcallbackfn, data->entrycallbackfn, data->callbackdata, 0, NULL);
+  struct pefile_list_imports_callback_struct* data = (struct pefile_list_imports_callback_struct*)callbackdata;
+  if (!functionname) {
+    char ordinalname[7];
+    snprintf(ordinalname, sizeof(ordinalname), "@%" PRIu16, ordinal);
+    return (data->callbackfn)(modulename, ordinalname, data->callbackdata);
+  }
+  return (data->callbackfn)(modulename, functionname, data->callbackdata);
 }
 
-DLL_EXPORT_PEDEPS int pefile_list_resources (pefile_handle pe_file, PEfile_list_resourcegroups_fn groupcallbackfn, PEfile_list_resources_fn entrycallbackfn, void* callbackdata)
+DLL_EXPORT_PEDEPS int pefile_list_imports (pefile_handle pe_file, PEfile_list_imports_fn callbackfn, void* callbackdata)
 {
-  struct pefile_list_resources_callback_struct data;
-  data.groupcallbackfn = groupcallbackfn;
-  data.entrycallbackfn = entrycallbackfn;
+  struct pefile_list_imports_callback_struct data;
+  data.callbackfn = callbackfn;
   data.callbackdata = callbackdata;
-  return pefile_iterate_sections(pe_file, PE_DATA_DIR_IDX_RESOURCE, resource_section_name, sizeof(struct peheader_imageresourcedirectory), (pefile_iterate_section_fn)pefile_process_resource_section, NULL, &data);
+  return pefile_list_imports_v2(pe_file, pefile_list_imports_callback, &data);
+}
+
+const char export_section_name[8] = {'.', 'e', 'd', 'a', 't', 'a', 0, 0};
+
+//get pointer to table in memory (returns NULL if not in memory or not properly aligned)
+static const void* get_export_table (pefile_handle pe_file, uint32_t rva, size_t tablelen)
+{
+  const void* data;
+  if ((data = get_image_data(pe_file, rva_to_offset(pe_file, rva), tablelen)) == NULL || ((uintptr_t)data % sizeof(uint32_t)) != 0)
+    return NULL;
+  return data;
+}
+
+//read table into the buffer at the specified position and advance the position
+static const void* read_export_table (pefile_handle pe_file, uint32_t rva, size_t tablelen, uint8_t* buf, size_t* bufpos)
+{
+  if (read_at(pe_file, rva_to_offset(pe_file, rva), buf + *bufpos, tablelen) < tablelen)
+    return NULL;
+  *bufpos += tablelen;
+  return buf + *bufpos - tablelen;
+}
+
+//read export directory tables for looking up exported symbols, returns non-zero if there are no exports
+static int export_cache_read (pefile_handle pe_file)
+{
+  struct peheader_imageexportdirectory imgexpdir;
+  struct pefile_export_cache_struct* cache = &(pe_file->exportcache);
+  uint32_t datadirentries;
+  size_t eatlen;
+  size_t entlen;
+  size_t eotlen;
+  size_t dirlen;
+  size_t buflen;
+  size_t bufpos = 0;
+  //get export directory from data directory
+  switch (pe_file->optionalheader->common.Signature) {
+    case PE_SIGNATURE_PE32:
+      datadirentries = pe_file->optionalheader->opt32.NumberOfRvaAndSizes;
+      break;
+    case PE_SIGNATURE_PE64:
+      datadirentries = pe_file->optionalheader->opt64.NumberOfRvaAndSizes;
+      break;
+    default:
+      return 1;
+  }
+  if (PE_DATA_DIR_IDX_EXPORT >= datadirentries || !pe_file->datadir[PE_DATA_DIR_IDX_EXPORT].VirtualAddress || pe_file->datadir[PE_DATA_DIR_IDX_EXPORT].Size < sizeof(imgexpdir))
+    return 1;
+  cache->directoryrva = pe_file->datadir[PE_DATA_DIR_IDX_EXPORT].VirtualAddress;
+  cache->directorylength = pe_file->datadir[PE_DATA_DIR_IDX_EXPORT].Size;
+  if (read_data_at(pe_file, rva_to_offset(pe_file, cache->directoryrva), &imgexpdir, sizeof(imgexpdir)) == NULL)
+    return 1;
+  if (imgexpdir.NumberOfFunctions > UINT32_MAX / sizeof(uint32_t) || imgexpdir.NumberOfNames > UINT32_MAX / sizeof(uint32_t))
+    return 1;
+  eatlen = (size_t)imgexpdir.NumberOfFunctions * sizeof(uint32_t);
+  entlen = (size_t)imgexpdir.NumberOfNames * sizeof(uint32_t);
+  eotlen = (size_t)imgexpdir.NumberOfNames * sizeof(uint16_t);
+  //use Export Address Table (EAT), Export Name Table (ENT) and Export Ordinal Table (EOT) in memory directly
+  cache->functionaddr = (const uint32_t*)get_export_table(pe_file, imgexpdir.AddressOfFunctions, eatlen);
+  cache->functionnamerva = (const uint32_t*)get_export_table(pe_file, imgexpdir.AddressOfNames, entlen);
+  cache->functionnameordinal = (const uint16_t*)get_export_table(pe_file, imgexpdir.AddressOfNameOrdinals, eotlen);
+  //keep the export directory itself (containing the forwarder names) available without the need for a string buffer shared between threads
+  dirlen = (cache->directorylength <= EXPORT_DIRECTORY_MAX_CACHE ? cache->directorylength : 0);
+  if ((cache->directorydata = (const uint8_t*)get_image_data(pe_file, rva_to_offset(pe_file, cache->directoryrva), cache->directorylength)) != NULL)
+    dirlen = 0;
+  //read tables that are not in memory into a single buffer
+  buflen = (cache->functionaddr ? 0 : eatlen) + (cache->functionnamerva ? 0 : entlen) + (cache->functionnameordinal ? 0 : eotlen) + dirlen;
+  if (buflen > 0) {
+    if ((cache->data = pe_malloc(pe_file, buflen)) == NULL ||
+        (!cache->functionaddr && (cache->functionaddr = (const uint32_t*)read_export_table(pe_file, imgexpdir.AddressOfFunctions, eatlen, (uint8_t*)cache->data, &bufpos)) == NULL) ||
+        (!cache->functionnamerva && (cache->functionnamerva = (const uint32_t*)read_export_table(pe_file, imgexpdir.AddressOfNames, entlen, (uint8_t*)cache->data, &bufpos)) == NULL) ||
+        (!cache->functionnameordinal && (cache->functionnameordinal = (const uint16_t*)read_export_table(pe_file, imgexpdir.AddressOfNameOrdinals, eotlen, (uint8_t*)cache->data, &bufpos)) == NULL)) {
+      export_cache_free(pe_file);
+      return 1;
+    }
+    //forwarder names are read one at a time when needed if the export directory isn't kept
+    if (dirlen > 0)
+      cache->directorydata = (const uint8_t*)read_export_table(pe_file, cache->directoryrva, dirlen, (uint8_t*)cache->data, &bufpos);
+  }
+  cache->base = imgexpdir.Base;
+  cache->functioncount = imgexpdir.NumberOfFunctions;
+  cache->namecount = imgexpdir.NumberOfNames;
+  return 0;
+}
+
+//load export directory tables the first time they are needed, returns non-zero if there are no exports
+static int export_cache_load (pefile_handle pe_file)
+{
+  struct pefile_export_cache_struct* cache = &(pe_file->exportcache);
+  int loaded;
+  if ((loaded = pe_atomic_load(&(cache->loaded))) == 0) {
+    //only one thread loads the tables, others wait until it's done
+    pe_mutex_lock(&(pe_file->initlock));
+    if ((loaded = cache->loaded) == 0) {
+      loaded = (export_cache_read(pe_file) == 0 ? 1 : -1);
+      pe_atomic_store(&(cache->loaded), loaded);
+    }
+    pe_mutex_unlock(&(pe_file->initlock));
+  }
+  return (loaded > 0 ? 0 : 1);
+}
+
+//read name of forwarder when the export directory is not kept in memory, the name is kept until the file is closed
+static const char* read_export_forwarder (pefile_handle pe_file, uint32_t addr, size_t* len)
+{
+  struct pefile_export_cache_struct* cache = &(pe_file->exportcache);
+  struct pefile_string_buffer_struct strbuf;
+  struct pefile_arena_struct* arena;
+  const char* name;
+  char* result = NULL;
+  if ((arena = arena_acquire(pe_file)) == NULL)
+    return NULL;
+  string_buffer_init(&strbuf, arena);
+  //the name must end within the export directory
+  if ((name = read_string_view_at(pe_file, rva_to_offset(pe_file, addr), &strbuf, len)) != NULL && *len < cache->directorylength - (addr - cache->directoryrva)) {
+    //the arena of the handle is shared between threads
+    pe_mutex_lock(&(pe_file->initlock));
+    if ((result = (char*)arena_alloc(pe_file, &(pe_file->arena), *len + 1)) != NULL)
+      memcpy(result, name, *len + 1);
+    pe_mutex_unlock(&(pe_file->initlock));
+  }
+  arena_giveback(pe_file, arena);
+  return result;
+}
+
+//get information about exported symbol with specified index in the Export Address Table
+static int get_export_info (pefile_handle pe_file, uint32_t index, int* isdata, const char** forwardername, size_t* forwardernamelen)
+{
+  struct pefile_export_cache_struct* cache = &(pe_file->exportcache);
+  const char* forwarder = NULL;
+  const char* end;
+  size_t forwarderlen = 0;
+  uint32_t addr;
+  //unused entries in the Export Address Table are zero
+  if (index >= cache->functioncount || (addr = cache->functionaddr[index]) == 0)
+    return PE_RESULT_NOT_FOUND;
+  //forwarded function if address points within export directory
+  if (forwardername && addr >= cache->directoryrva && addr - cache->directoryrva < cache->directorylength) {
+    if (cache->directorydata) {
+      forwarder = (const char*)cache->directorydata + (addr - cache->directoryrva);
+      if ((end = (const char*)memchr(forwarder, 0, cache->directorylength - (addr - cache->directoryrva))) != NULL)
+        forwarderlen = end - forwarder;
+      else
+        forwarder = NULL;
+    } else {
+      forwarder = read_export_forwarder(pe_file, addr, &forwarderlen);
+    }
+  }
+  if (isdata)
+    *isdata = is_export_data(pe_file, addr);
+  if (forwardername)
+    *forwardername = forwarder;
+  if (forwardernamelen)
+    *forwardernamelen = forwarderlen;
+  return PE_RESULT_SUCCESS;
+}
+
+//find index of name in Export Name Table, first trying hint as index (like the Windows loader) and falling back to a binary search
+static int find_export_name_index (pefile_handle pe_file, const char* name, size_t namelen, uint32_t hint, uint32_t* index)
+{
+  struct pefile_export_cache_struct* cache = &(pe_file->exportcache);
+  uint32_t first = 0;
+  uint32_t last;
+  uint32_t middle;
+  int cmp;
+  if (export_cache_load(pe_file) != 0)
+    return PE_RESULT_NOT_FOUND;
+  //check entry hint points to
+  if (hint < cache->namecount && compare_string_at(pe_file, rva_to_offset(pe_file, cache->functionnamerva[hint]), name, namelen) == 0) {
+    *index = hint;
+    return PE_RESULT_SUCCESS;
+  }
+  //binary search in Export Name Table (sorted lexically)
+  last = cache->namecount;
+  while (first < last) {
+    middle = first + (last - first) / 2;
+    if ((cmp = compare_string_at(pe_file, rva_to_offset(pe_file, cache->functionnamerva[middle]), name, namelen)) == 0) {
+      *index = middle;
+      return PE_RESULT_SUCCESS;
+    }
+    if (cmp < 0)
+      first = middle + 1;
+    else
+      last = middle;
+  }
+  return PE_RESULT_NOT_FOUND;
+}
+
+//get information about exported symbol with specified index in the Export Name Table
+static int get_named_export_info (pefile_handle pe_file, uint32_t index, uint16_t* ordinal, int* isdata, const char** forwardername, size_t* forwardernamelen)
+{
+  if (ordinal)
+    *ordinal = (uint16_t)(pe_file->exportcache.functionnameordinal[index] + pe_file->exportcache.base);
+  return get_export_info(pe_file, pe_file->exportcache.functionnameordinal[index], isdata, forwardername, forwardernamelen);
+}
+
+DLL_EXPORT_PEDEPS int pefile_find_export_by_name (pefile_handle pe_file, const char* name, uint16_t* ordinal, int* isdata, const char** forwardername, size_t* forwardernamelen)
+{
+  uint32_t index;
+  if (find_export_name_index(pe_file, name, strlen(name), UINT32_MAX, &index) != PE_RESULT_SUCCESS)
+    return PE_RESULT_NOT_FOUND;
+  return get_named_export_info(pe_file, index, ordinal, isdata, forwardername, forwardernamelen);
+}
+
+DLL_EXPORT_PEDEPS int pefile_find_export_by_hint (pefile_handle pe_file, const char* name, uint16_t hint, uint16_t* ordinal, int* isdata, const char** forwardername, size_t* forwardernamelen)
+{
+  uint32_t index;
+  if (find_export_name_index(pe_file, name, strlen(name), hint, &index) != PE_RESULT_SUCCESS)
+    return PE_RESULT_NOT_FOUND;
+  return get_named_export_info(pe_file, index, ordinal, isdata, forwardername, forwardernamelen);
+}
+
+DLL_EXPORT_PEDEPS int pefile_find_export_by_ordinal (pefile_handle pe_file, uint16_t ordinal, int* isdata, const char** forwardername, size_t* forwardernamelen)
+{
+  if (export_cache_load(pe_file) != 0)
+    return PE_RESULT_NOT_FOUND;
+  //index Export Address Table directly
+  if (ordinal < pe_file->exportcache.base)
+    return PE_RESULT_NOT_FOUND;
+  return get_export_info(pe_file, ordinal - pe_file->exportcache.base, isdata, forwardername, forwardernamelen);
+}
+
+DLL_EXPORT_PEDEPS int pefile_check_import_bindings (pefile_handle pe_file, const struct pefile_imports_struct* imports, uint32_t moduleindex, PEfile_check_import_binding_fn callbackfn, void* callbackdata)
+{
+  const struct pefile_import_struct* entry;
+  const struct pefile_import_struct* lastentry;
+  uint32_t index;
+  uint16_t ordinal;
+  int isdata;
+  const char* forwardername;
+  size_t forwardernamelen;
+  int result;
+  if (moduleindex >= imports->modulecount)
+    return PE_RESULT_NOT_FOUND;
+  entry = imports->imports + imports->modules[moduleindex].firstimport;
+  lastentry = entry + imports->modules[moduleindex].importcount;
+  for (; entry < lastentry; entry++) {
+    //resolve by ordinal or by name using hint
+    isdata = 0;
+    forwardername = NULL;
+    forwardernamelen = 0;
+    if (entry->byordinal) {
+      ordinal = entry->ordinal;
+      result = pefile_find_export_by_ordinal(pe_file, ordinal, &isdata, &forwardername, &forwardernamelen);
+    } else {
+      ordinal = 0;
+      if ((result = find_export_name_index(pe_file, imports->strings + entry->name, entry->namelen, entry->hint, &index)) == PE_RESULT_SUCCESS)
+        result = get_named_export_info(pe_file, index, &ordinal, &isdata, &forwardername, &forwardernamelen);
+    }
+    if (callbackfn && (*callbackfn)(entry, (result == PE_RESULT_SUCCESS ? 1 : 0), ordinal, isdata, forwardername, forwardernamelen, callbackdata) != 0)
+      break;
+  }
+  return PE_RESULT_SUCCESS;
+}
+
+DLL_EXPORT_PEDEPS int pefile_list_exports_v2 (pefile_handle pe_file, PEfile_list_exports_v2_fn callbackfn, void* callbackdata)
+{
+  return pefile_iterate_sections (pe_file, PE_DATA_DIR_IDX_EXPORT, export_section_name, sizeof(struct peheader_imageexportdirectory), (pefile_iterate_section_fn)pefile_process_export_section, callbackfn, callbackdata);
+}
+
+struct pefile_list_exports_callback_struct {
+  PEfile_list_exports_fn callbackfn;
+  void* callbackdata;
+};
+
+static int pefile_list_exports_callback (const char* modulename, size_t modulenamelen, const char* functionname, size_t functionnamelen, uint16_t ordinal, int isdata, const char* functionforwardername, size_t functionforwardernamelen, void* callbackdata)
+{
+  struct pefile_list_exports_callback_struct* data = (struct pefile_list_exports_callback_struct*)callbackdata;
+  return (data->callbackfn)(modulename, functionname, ordinal, isdata, (char*)functionforwardername, data->callbackdata);
+}
+
+DLL_EXPORT_PEDEPS int pefile_list_exports (pefile_handle pe_file, PEfile_list_exports_fn callbackfn, void* callbackdata)
+{
+  struct pefile_list_exports_callback_struct data;
+  data.callbackfn = callbackfn;
+  data.callbackdata = callbackdata;
+  return pefile_list_exports_v2(pe_file, pefile_list_exports_callback, &data);
+}
+
+const char resource_section_name[8] = {'.', 'r', 's', 'r', 'c', 0, 0, 0};
+
+int pefile_process_resource_directory (pefile_handle pe_file, struct pefile_arena_struct* arena, uint32_t startrva, uint32_t rva, PEfile_list_resourcegroups_fn groupcallbackfn, PEfile_list_resources_fn entrycallbackfn, void* callbackdata, unsigned int level, struct pefile_resource_directory_struct* parentinfo)
+{
+  uint32_t i;
+  struct peheader_imageresourcedirectory imgresdir;
+  struct peheader_imageresourcedirectory_entry* resentries;
+  struct peheader_imageresourcedirectory_entry* resentry;
+  int cbresult = PE_CB_RETURN_CONTINUE;
+  uint64_t fileposition;
+  struct pefile_arena_mark_struct arenamark = arena_mark(arena);
+  int abort = 0;
+  //read resource directory
+  if (read_data_at(pe_file, (fileposition = rva_to_offset(pe_file, rva)), &imgresdir, sizeof(imgresdir)) == NULL)
+    return PE_CB_RETURN_ERROR;
+  //read resource entries
+  if ((resentries = read_arena_data_at(pe_file, arena, fileposition + sizeof(imgresdir), (imgresdir.NumberOfNamedEntries + imgresdir.NumberOfIdEntries) * sizeof(struct peheader_imageresourcedirectory_entry))) == NULL) {
+    arena_release(arena, arenamark);
+    return PE_CB_RETURN_ERROR;
+  }
+  resentry = resentries;
+  //read resource entries
+  for (i = 0; !abort && i < imgresdir.NumberOfNamedEntries + imgresdir.NumberOfIdEntries; i++) {
+    if ((resentry->OffsetToData & PE_RESOURCE_ENTRY_DIR_MASK) != 0) {
+      //resource entry is a directory
+      struct pefile_resource_directory_struct info;
+      info.parent = parentinfo;
+      info.name = NULL;
+      if ((info.isnamed = ((resentry->Name & PE_RESOURCE_ENTRY_NAME_MASK) != 0 ? 1 : 0)) != 0) {
+        //named entry
+        info.id = 0;
+        info.name = read_len_wstring_at(pe_file, arena, rva_to_offset(pe_file, startrva + (resentry->Name & ~PE_RESOURCE_ENTRY_NAME_MASK)));
+      } else {
+        //entry identified by ID
+        info.id = resentry->Name;
+      }
+      if (!parentinfo && groupcallbackfn)
+        cbresult = groupcallbackfn(&info, callbackdata);
+      if (cbresult == PE_CB_RETURN_CONTINUE || cbresult == PE_CB_RETURN_LAST)
+        cbresult = pefile_process_resource_directory(pe_file, arena, startrva, startrva + (resentry->OffsetToData & ~PE_RESOURCE_ENTRY_DIR_MASK), groupcallbackfn, entrycallbackfn, callbackdata, level + 1, &info);
+      else if (cbresult != PE_CB_RETURN_SKIP)
+        abort = 1;
+      if (cbresult == PE_CB_RETURN_LAST || cbresult == PE_CB_RETURN_ABORT)
+        break;
+    } else {
+      //resource entry is data
+      struct peheader_imageresource_data_entry resdata;
+      uint64_t dataposition;
+      if (read_data_at(pe_file, rva_to_offset(pe_file, startrva + resentry->OffsetToData), &resdata, sizeof(resdata)) && (dataposition = rva_to_offset(pe_file, resdata.OffsetToData)) != PE_INVALID_OFFSET) {
+        cbresult = entrycallbackfn(pe_file, parentinfo, (uint32_t)dataposition, resdata.Size, resdata.CodePage, callbackdata);
+        if (cbresult == PE_CB_RETURN_ABORT)
+          abort = 1;
+      }
+    }
+    resentry++;
+  }
+  //clean up
+  arena_release(arena, arenamark);
+  return (abort ? PE_CB_RETURN_ABORT : PE_CB_RETURN_ABORT);
+}
+
+struct pefile_list_resources_callback_struct {
+  PEfile_list_resourcegroups_fn groupcallbackfn;
+  PEfile_list_resources_fn entrycallbackfn;
+  void* callbackdata;
+};
+
+int pefile_process_resource_section (pefile_handle pe_file, uint32_t directoryrva, uint32_t directorylength, PEfile_list_resources_fn callbackfn, void* callbackdata)
+{
+  struct pefile_list_resources_callback_struct* data = (struct pefile_list_resources_callback_struct*)callbackdata;
+  struct pefile_arena_struct* arena;
+  int result;
+  //get arena for directory entries and names (not shared with other threads processing the same file)
+  if ((arena = arena_acquire(pe_file)) == NULL)
+    return PE_CB_RETURN_ERROR;
+  result = pefile_process_resource_directory(pe_file, arena, directoryrva, directoryrva, data->groupcallbackfn, data->entrycallbackfn, data->callbackdata, 0, NULL);
+  arena_giveback(pe_file, arena);
+  return result;
+}
+
+DLL_EXPORT_PEDEPS int pefile_list_resources (pefile_handle pe_file, PEfile_list_resourcegroups_fn groupcallbackfn, PEfile_list_resources_fn entrycallbackfn, void* callbackdata)
+{
+  struct pefile_list_resources_callback_struct data;
+  data.groupcallbackfn = groupcallbackfn;
+  data.entrycallbackfn = entrycallbackfn;
+  data.callbackdata = callbackdata;
+  return pefile_iterate_sections(pe_file, PE_DATA_DIR_IDX_RESOURCE, resource_section_name, sizeof(struct peheader_imageresourcedirectory), (pefile_iterate_section_fn)pefile_process_resource_section, NULL, &data);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+struct pefile_scan_worker_struct {
+  struct pefile_scan_batch_struct* batch;
+  pe_mutex lock;
+  size_t next;
+  size_t end;
+  pe_thread thread;
+  int threadstarted;
+  int result;
+};
+
+struct pefile_scan_batch_struct {
+  const char* const* paths;
+  PEfile_scan_batch_fn callbackfn;
+  void* callbackdata;
+  int wantexports;
+  struct pefile_scan_worker_struct* workers;
+  unsigned int workercount;
+  int abort;
+};
+
+//get index of next file to process, taken from the range of the worker or stolen from the end of the range of another worker, returns 0 if no work is left
+static int scan_take_work (struct pefile_scan_worker_struct* worker, size_t* index)
+{
+  struct pefile_scan_batch_struct* batch = worker->batch;
+  struct pefile_scan_worker_struct* victim;
+  unsigned int i;
+  size_t first;
+  size_t end;
+  if (pe_atomic_load(&(batch->abort)))
+    return 0;
+  //take next file from own range
+  pe_mutex_lock(&(worker->lock));
+  if (worker->next < worker->end) {
+    *index = worker->next++;
+    pe_mutex_unlock(&(worker->lock));
+    return 1;
+  }
+  pe_mutex_unlock(&(worker->lock));
+  //steal the second half of the remaining range of another worker
+  for (i = 1; i < batch->workercount; i++) {
+    victim = &(batch->workers[(worker - batch->workers + i) % batch->workercount]);
+    pe_mutex_lock(&(victim->lock));
+    if (victim->next < victim->end) {
+      end = victim->end;
+      first = victim->end - (victim->end - victim->next + 1) / 2;
+      victim->end = first;
+      pe_mutex_unlock(&(victim->lock));
+      pe_mutex_lock(&(worker->lock));
+      *index = first;
+      worker->next = first + 1;
+      worker->end = end;
+      pe_mutex_unlock(&(worker->lock));
+      return 1;
+    }
+    pe_mutex_unlock(&(victim->lock));
+  }
+  return 0;
+}
+
+//fill probe information from the headers of an open file
+static void get_probe_info (pefile_handle pe_file, struct pefile_probe_info_struct* info)
+{
+  uint32_t datadirentries;
+  uint32_t i;
+  memset(info, 0, sizeof(struct pefile_probe_info_struct));
+  info->signature = pe_file->optionalheader->common.Signature;
+  info->machine = pe_file->coffheader.Machine;
+  info->subsystem = pe_file->pecommonext->Subsystem;
+  info->characteristics = pe_file->coffheader.Characteristics;
+  info->isdll = pefile_is_dll(pe_file);
+  info->imagebase = pefile_get_image_base_address(pe_file);
+  info->sectioncount = pe_file->coffheader.NumberOfSections;
+  datadirentries = (info->signature == PE_SIGNATURE_PE64 ? pe_file->optionalheader->opt64.NumberOfRvaAndSizes : pe_file->optionalheader->opt32.NumberOfRvaAndSizes);
+  //only use data directories within the optional header
+  if ((uint8_t*)pe_file->datadir - (uint8_t*)pe_file->optionalheader > pe_file->coffheader.SizeOfOptionalHeader)
+    datadirentries = 0;
+  else if (datadirentries > (pe_file->coffheader.SizeOfOptionalHeader - ((uint8_t*)pe_file->datadir - (uint8_t*)pe_file->optionalheader)) / sizeof(struct PEheader_data_directory))
+    datadirentries = (pe_file->coffheader.SizeOfOptionalHeader - ((uint8_t*)pe_file->datadir - (uint8_t*)pe_file->optionalheader)) / sizeof(struct PEheader_data_directory);
+  for (i = 0; i < datadirentries && i < PE_DATA_DIR_IDX_COUNT; i++) {
+    if (pe_file->datadir[i].VirtualAddress && pe_file->datadir[i].Size)
+      info->datadirectories |= (1 << i);
+  }
+}
+
+//process files until no work is left, using one handle (with its arena) for all files
+static PE_THREAD_FN(scan_worker_thread, arg)
+{
+  struct pefile_scan_worker_struct* worker = (struct pefile_scan_worker_struct*)arg;
+  struct pefile_scan_batch_struct* batch = worker->batch;
+  struct pefile_scan_result_struct scanresult;
+  pefile_handle pe_file;
+  size_t index;
+  if ((pe_file = pefile_create()) == NULL) {
+    worker->result = PE_RESULT_OUT_OF_MEMORY;
+    return PE_THREAD_RETURN;
+  }
+  while (scan_take_work(worker, &index)) {
+    memset(&scanresult, 0, sizeof(scanresult));
+    scanresult.index = index;
+    scanresult.filename = batch->paths[index];
+    //open file, get header information, imports and export tables
+    if ((scanresult.status = pefile_open_file(pe_file, scanresult.filename)) == PE_RESULT_SUCCESS) {
+      get_probe_info(pe_file, &(scanresult.info));
+      if ((scanresult.status = pefile_get_imports(pe_file, &(scanresult.imports))) == PE_RESULT_SUCCESS) {
+        scanresult.pe_file = pe_file;
+        if (batch->wantexports && export_cache_load(pe_file) == 0) {
+          scanresult.exportcount = pe_file->exportcache.functioncount;
+          scanresult.namedexportcount = pe_file->exportcache.namecount;
+        }
+      } else {
+        scanresult.imports = NULL;
+      }
+    }
+    //run callback function and stop all workers if requested
+    if ((worker->result = (batch->callbackfn)(&scanresult, batch->callbackdata)) != 0)
+      pe_atomic_store(&(batch->abort), 1);
+    pefile_close(pe_file);
+  }
+  pefile_destroy(pe_file);
+  return PE_THREAD_RETURN;
+}
+
+//process files using a pool of worker threads, export tables are only loaded if wantexports is non-zero
+static int scan_batch (const char* const* paths, size_t count, unsigned int nthreads, int wantexports, PEfile_scan_batch_fn callbackfn, void* callbackdata)
+{
+  struct pefile_scan_batch_struct batch;
+  unsigned int i;
+  int result = PE_RESULT_SUCCESS;
+  if (count == 0)
+    return PE_RESULT_SUCCESS;
+  //use one worker per processor by default, but not more than there are files
+  if (nthreads == 0)
+    nthreads = get_processor_count();
+  if (nthreads > count)
+    nthreads = (unsigned int)count;
+  batch.paths = paths;
+  batch.callbackfn = callbackfn;
+  batch.callbackdata = callbackdata;
+  batch.wantexports = wantexports;
+  batch.workercount = nthreads;
+  batch.abort = 0;
+  if ((batch.workers = (struct pefile_scan_worker_struct*)(global_malloc_fn)(sizeof(struct pefile_scan_worker_struct) * nthreads, global_memuserdata)) == NULL)
+    return PE_RESULT_OUT_OF_MEMORY;
+  //divide files evenly over workers (workers that finish early steal from the others)
+  for (i = 0; i < nthreads; i++) {
+    batch.workers[i].batch = &batch;
+    pe_mutex_init(&(batch.workers[i].lock));
+    batch.workers[i].next = count * i / nthreads;
+    batch.workers[i].end = count * (i + 1) / nthreads;
+    batch.workers[i].threadstarted = 0;
+    batch.workers[i].result = 0;
+  }
+  //start worker threads, the calling thread is the first worker (files of workers that could not be started are stolen by the others)
+  for (i = 1; i < nthreads; i++)
+    batch.workers[i].threadstarted = (pe_thread_create(&(batch.workers[i].thread), scan_worker_thread, &(batch.workers[i])) == 0 ? 1 : 0);
+  scan_worker_thread(&(batch.workers[0]));
+  //wait for workers to finish (they may still steal from each other until then)
+  for (i = 1; i < nthreads; i++) {
+    if (batch.workers[i].threadstarted)
+      pe_thread_join(batch.workers[i].thread);
+  }
+  //return the first error or callback result
+  for (i = 0; i < nthreads; i++) {
+    if (result == PE_RESULT_SUCCESS)
+      result = batch.workers[i].result;
+    pe_mutex_destroy(&(batch.workers[i].lock));
+  }
+  (global_free_fn)(batch.workers, global_memuserdata);
+  return result;
+}
+
+DLL_EXPORT_PEDEPS int pefile_scan_batch (const char* const* paths, size_t count, unsigned int nthreads, PEfile_scan_batch_fn callbackfn, void* callbackdata)
+{
+  return scan_batch(paths, count, nthreads, 1, callbackfn, callbackdata);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+#define DEPGRAPH_PATHSEPARATOR '\\'
+#define DEPGRAPH_ISPATHSEPARATOR(c) ((c) == '\\' || (c) == '/')
+#define DEPGRAPH_PATHCASEFOLD 1
+#else
+#define DEPGRAPH_PATHSEPARATOR '/'
+#define DEPGRAPH_ISPATHSEPARATOR(c) ((c) == '/')
+#define DEPGRAPH_PATHCASEFOLD 0
+#endif
+#define DEPGRAPH_TABLE_INITIAL_SLOTS 64
+#define DEPGRAPH_TABLE_INITIAL_NAMES 1024
+//search result of an atom (or the index of the search path + DEPGRAPH_SEARCH_FOUND)
+#define DEPGRAPH_SEARCH_PENDING 0
+#define DEPGRAPH_SEARCH_NOT_FOUND 1
+#define DEPGRAPH_SEARCH_FOUND 2
+
+//hash table of strings stored in a string pool, each with a value
+struct depgraph_table_entry_struct {
+  size_t nameoffset;
+  uint32_t value;
+};
+
+struct depgraph_table_struct {
+  int casefold;
+  char* names;
+  size_t nameslen;
+  size_t namesallocated;
+  struct depgraph_table_entry_struct* entries;
+  size_t entriesallocated;
+  uint32_t count;
+  uint32_t* slots;                      //index + 1 of the entry (0 if slot is unused)
+  uint32_t slotcount;
+};
+
+//snapshot of the file names in a folder
+struct depgraph_folder_struct {
+  char* path;
+  struct depgraph_table_struct files;
+};
+
+struct depgraph_atom_struct {
+  uint32_t firstmodule;                 //first module with this name
+  uint32_t missingmodule;               //module used for this name if it can't be found
+  uint32_t searchresult;                //DEPGRAPH_SEARCH_* or search path index + DEPGRAPH_SEARCH_FOUND
+};
+
+struct depgraph_module_struct {
+  uint32_t atom;
+  uint32_t path;                        //entry in the table of paths (PEDEPS_DEPGRAPH_NONE if not found)
+  uint32_t rootfolder;                  //folder of the root through which the module was found (PEDEPS_DEPGRAPH_NONE if none)
+  unsigned int flags;
+  int processed;
+  uint32_t cycle;
+  uint32_t* dependencies;
+  size_t dependenciesallocated;
+  uint32_t dependencycount;
+  char* imports;                        //imported module names, each followed by a null character
+  size_t importslen;
+  size_t importsallocated;
+  uint32_t importcount;
+};
+
+struct pedeps_depgraph_struct {
+  PEmem_malloc_fn malloc_fn;
+  PEmem_realloc_fn realloc_fn;
+  PEmem_free_fn free_fn;
+  void* memuserdata;
+  unsigned int flags;
+  PEdepgraph_get_imports_fn importsfn;
+  void* importsdata;
+  struct depgraph_table_struct atomtable;
+  struct depgraph_atom_struct* atoms;
+  size_t atomsallocated;
+  uint32_t atomcount;
+  struct depgraph_table_struct pathtable;
+  struct depgraph_module_struct* modules;
+  size_t modulesallocated;
+  uint32_t modulecount;
+  struct depgraph_folder_struct** searchfolders;
+  size_t searchfoldersallocated;
+  uint32_t searchfoldercount;
+  struct depgraph_table_struct rootfoldertable;
+  struct depgraph_folder_struct** rootfolders;
+  size_t rootfoldersallocated;
+  uint32_t rootfoldercount;
+  struct depgraph_folder_struct* currentfolder;
+  //compressed adjacency arrays, topological order and cycles (updated by pedeps_depgraph_build())
+  uint32_t* dependencystart;
+  uint32_t* dependencylist;
+  uint32_t* dependentstart;
+  uint32_t* dependentlist;
+  uint32_t* order;
+  uint32_t builtcount;                  //number of modules when the graph was last built
+  uint32_t cyclecount;
+};
+
+static inline void* depgraph_malloc (pedeps_depgraph_handle graph, size_t size)
+{
+  return (graph->malloc_fn)(size, graph->memuserdata);
+}
+
+static inline void* depgraph_realloc (pedeps_depgraph_handle graph, void* ptr, size_t size)
+{
+  return (graph->realloc_fn)(ptr, size, graph->memuserdata);
+}
+
+static inline void depgraph_free (pedeps_depgraph_handle graph, void* ptr)
+{
+  if (ptr)
+    (graph->free_fn)(ptr, graph->memuserdata);
+}
+
+static int depgraph_grow_array (pedeps_depgraph_handle graph, void** data, size_t* allocated, size_t needed, size_t elementsize)
+{
+  void* newdata;
+  size_t newsize;
+  if (needed <= *allocated)
+    return 0;
+  newsize = (*allocated ? *allocated * 2 : 16);
+  while (newsize < needed)
+    newsize *= 2;
+  if ((newdata = depgraph_realloc(graph, *data, newsize * elementsize)) == NULL)
+    return -1;
+  *data = newdata;
+  *allocated = newsize;
+  return 0;
+}
+
+static char* depgraph_strdup (pedeps_depgraph_handle graph, const char* str)
+{
+  char* result;
+  size_t len = strlen(str) + 1;
+  if ((result = (char*)depgraph_malloc(graph, len)) != NULL)
+    memcpy(result, str, len);
+  return result;
+}
+
+static inline char depgraph_fold (char c, int casefold)
+{
+  return (casefold && c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+}
+
+static int depgraph_compare_names (const char* name1, const char* name2, int casefold)
+{
+  while (*name1 && depgraph_fold(*name1, casefold) == depgraph_fold(*name2, casefold)) {
+    name1++;
+    name2++;
+  }
+  return (*name1 || *name2);
+}
+
+//FNV-1a hash
+static uint32_t depgraph_hash (const char* name, int casefold)
+{
+  uint32_t hash = 2166136261u;
+  while (*name) {
+    hash ^= (uint8_t)depgraph_fold(*name++, casefold);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static void depgraph_table_init (struct depgraph_table_struct* table, int casefold)
+{
+  memset(table, 0, sizeof(struct depgraph_table_struct));
+  table->casefold = casefold;
+}
+
+static void depgraph_table_free (pedeps_depgraph_handle graph, struct depgraph_table_struct* table)
+{
+  depgraph_free(graph, table->names);
+  depgraph_free(graph, table->entries);
+  depgraph_free(graph, table->slots);
+  depgraph_table_init(table, table->casefold);
+}
+
+static inline const char* depgraph_table_name (const struct depgraph_table_struct* table, uint32_t entry)
+{
+  return table->names + table->entries[entry].nameoffset;
+}
+
+//get slot for name (either the slot containing it or the empty slot where it should go)
+static uint32_t* depgraph_table_get_slot (const struct depgraph_table_struct* table, const char* name)
+{
+  uint32_t i = depgraph_hash(name, table->casefold) & (table->slotcount - 1);
+  while (table->slots[i] && depgraph_compare_names(depgraph_table_name(table, table->slots[i] - 1), name, table->casefold) != 0)
+    i = (i + 1) & (table->slotcount - 1);
+  return &(table->slots[i]);
+}
+
+//look up name, returns entry index or PEDEPS_DEPGRAPH_NONE if not found
+static uint32_t depgraph_table_find (const struct depgraph_table_struct* table, const char* name)
+{
+  if (table->count == 0)
+    return PEDEPS_DEPGRAPH_NONE;
+  return *depgraph_table_get_slot(table, name) - 1;
+}
+
+//add name (if not already in the table), returns entry index or PEDEPS_DEPGRAPH_NONE on memory allocation error
+static uint32_t depgraph_table_add (pedeps_depgraph_handle graph, struct depgraph_table_struct* table, const char* name, uint32_t value)
+{
+  uint32_t* slot;
+  uint32_t* newslots;
+  uint32_t i;
+  size_t len;
+  //grow hash table when it is half full
+  if ((table->count + 1) * 2 > table->slotcount) {
+    uint32_t newslotcount = (table->slotcount ? table->slotcount * 2 : DEPGRAPH_TABLE_INITIAL_SLOTS);
+    if ((newslots = (uint32_t*)depgraph_malloc(graph, newslotcount * sizeof(uint32_t))) == NULL)
+      return PEDEPS_DEPGRAPH_NONE;
+    memset(newslots, 0, newslotcount * sizeof(uint32_t));
+    depgraph_free(graph, table->slots);
+    table->slots = newslots;
+    table->slotcount = newslotcount;
+    for (i = 0; i < table->count; i++)
+      *depgraph_table_get_slot(table, depgraph_table_name(table, i)) = i + 1;
+  }
+  if (*(slot = depgraph_table_get_slot(table, name)))
+    return *slot - 1;
+  //store name in string pool
+  len = strlen(name) + 1;
+  if (depgraph_grow_array(graph, (void**)&(table->names), &(table->namesallocated), (table->nameslen + len > DEPGRAPH_TABLE_INITIAL_NAMES ? table->nameslen + len : DEPGRAPH_TABLE_INITIAL_NAMES), 1) != 0)
+    return PEDEPS_DEPGRAPH_NONE;
+  if (depgraph_grow_array(graph, (void**)&(table->entries), &(table->entriesallocated), table->count + 1, sizeof(struct depgraph_table_entry_struct)) != 0)
+    return PEDEPS_DEPGRAPH_NONE;
+  memcpy(table->names + table->nameslen, name, len);
+  table->entries[table->count].nameoffset = table->nameslen;
+  table->entries[table->count].value = value;
+  table->nameslen += len;
+  *slot = ++table->count;
+  return table->count - 1;
+}
+
+static int depgraph_file_exists (const char* path)
+{
+#ifdef _WIN32
+  DWORD attributes = GetFileAttributesA(path);
+  return (attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY));
+#else
+  struct stat statbuf;
+  return (stat(path, &statbuf) == 0 && S_ISREG(statbuf.st_mode));
+#endif
+}
+
+//read the file names in a folder once (current folder if path is empty), an unreadable folder results in an empty snapshot
+static struct depgraph_folder_struct* depgraph_folder_create (pedeps_depgraph_handle graph, const char* path)
+{
+  struct depgraph_folder_struct* folder;
+  if ((folder = (struct depgraph_folder_struct*)depgraph_malloc(graph, sizeof(struct depgraph_folder_struct))) == NULL)
+    return NULL;
+  if ((folder->path = depgraph_strdup(graph, path)) == NULL) {
+    depgraph_free(graph, folder);
+    return NULL;
+  }
+  depgraph_table_init(&(folder->files), graph->flags & PEDEPS_DEPGRAPH_CASE_INSENSITIVE);
+  {
+#ifdef _WIN32
+    HANDLE findhandle;
+    WIN32_FIND_DATAA finddata;
+    char* pattern;
+    size_t len = strlen(path);
+    if ((pattern = (char*)depgraph_malloc(graph, len + 3)) != NULL) {
+      memcpy(pattern, path, len);
+      strcpy(pattern + len, (len == 0 || DEPGRAPH_ISPATHSEPARATOR(path[len - 1]) ? "*" : "\\*"));
+      if ((findhandle = FindFirstFileA(pattern, &finddata)) != INVALID_HANDLE_VALUE) {
+        do {
+          if (!(finddata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            depgraph_table_add(graph, &(folder->files), finddata.cFileName, 0);
+        } while (FindNextFileA(findhandle, &finddata));
+        FindClose(findhandle);
+      }
+      depgraph_free(graph, pattern);
+    }
+#else
+    DIR* dirhandle;
+    struct dirent* direntry;
+    if ((dirhandle = opendir(*path ? path : ".")) != NULL) {
+      while ((direntry = readdir(dirhandle)) != NULL) {
+        if (strcmp(direntry->d_name, ".") != 0 && strcmp(direntry->d_name, "..") != 0)
+          depgraph_table_add(graph, &(folder->files), direntry->d_name, 0);
+      }
+      closedir(dirhandle);
+    }
+#endif
+  }
+  return folder;
+}
+
+static void depgraph_folder_free (pedeps_depgraph_handle graph, struct depgraph_folder_struct* folder)
+{
+  if (folder) {
+    depgraph_table_free(graph, &(folder->files));
+    depgraph_free(graph, folder->path);
+    depgraph_free(graph, folder);
+  }
+}
+
+//get full path of file in folder if it exists, returns NULL if not found
+static char* depgraph_folder_get_path (pedeps_depgraph_handle graph, const struct depgraph_folder_struct* folder, const char* filename)
+{
+  uint32_t entry;
+  const char* name;
+  char* path;
+  size_t len;
+  if ((entry = depgraph_table_find(&(folder->files), filename)) == PEDEPS_DEPGRAPH_NONE)
+    return NULL;
+  name = depgraph_table_name(&(folder->files), entry);
+  len = strlen(folder->path);
+  if ((path = (char*)depgraph_malloc(graph, len + strlen(name) + 2)) == NULL)
+    return NULL;
+  memcpy(path, folder->path, len);
+  //add separator unless the folder already ends with one (e.g. the root folder)
+  if (len > 0 && !DEPGRAPH_ISPATHSEPARATOR(folder->path[len - 1]))
+    path[len++] = DEPGRAPH_PATHSEPARATOR;
+  strcpy(path + len, name);
+  //make sure it's a file and it still exists
+  if (!depgraph_file_exists(path)) {
+    depgraph_free(graph, path);
+    return NULL;
+  }
+  return path;
+}
+
+static void depgraph_free_results (pedeps_depgraph_handle graph)
+{
+  depgraph_free(graph, graph->dependencystart);
+  depgraph_free(graph, graph->dependencylist);
+  depgraph_free(graph, graph->dependentstart);
+  depgraph_free(graph, graph->dependentlist);
+  depgraph_free(graph, graph->order);
+  graph->dependencystart = NULL;
+  graph->dependencylist = NULL;
+  graph->dependentstart = NULL;
+  graph->dependentlist = NULL;
+  graph->order = NULL;
+  graph->builtcount = 0;
+  graph->cyclecount = 0;
+}
+
+DLL_EXPORT_PEDEPS pedeps_depgraph_handle pedeps_depgraph_create (unsigned int flags)
+{
+  pedeps_depgraph_handle graph;
+  if ((graph = (pedeps_depgraph_handle)(global_malloc_fn)(sizeof(struct pedeps_depgraph_struct), global_memuserdata)) == NULL)
+    return NULL;
+  memset(graph, 0, sizeof(struct pedeps_depgraph_struct));
+  graph->malloc_fn = global_malloc_fn;
+  graph->realloc_fn = global_realloc_fn;
+  graph->free_fn = global_free_fn;
+  graph->memuserdata = global_memuserdata;
+  graph->flags = flags;
+  depgraph_table_init(&(graph->atomtable), flags & PEDEPS_DEPGRAPH_CASE_INSENSITIVE);
+  //paths are only case insensitive on Windows
+  depgraph_table_init(&(graph->pathtable), DEPGRAPH_PATHCASEFOLD);
+  depgraph_table_init(&(graph->rootfoldertable), DEPGRAPH_PATHCASEFOLD);
+  return graph;
+}
+
+DLL_EXPORT_PEDEPS void pedeps_depgraph_destroy (pedeps_depgraph_handle graph)
+{
+  uint32_t i;
+  if (!graph)
+    return;
+  for (i = 0; i < graph->modulecount; i++) {
+    depgraph_free(graph, graph->modules[i].dependencies);
+    depgraph_free(graph, graph->modules[i].imports);
+  }
+  depgraph_free(graph, graph->modules);
+  for (i = 0; i < graph->searchfoldercount; i++)
+    depgraph_folder_free(graph, graph->searchfolders[i]);
+  depgraph_free(graph, graph->searchfolders);
+  for (i = 0; i < graph->rootfoldercount; i++)
+    depgraph_folder_free(graph, graph->rootfolders[i]);
+  depgraph_free(graph, graph->rootfolders);
+  depgraph_folder_free(graph, graph->currentfolder);
+  depgraph_table_free(graph, &(graph->atomtable));
+  depgraph_table_free(graph, &(graph->pathtable));
+  depgraph_table_free(graph, &(graph->rootfoldertable));
+  depgraph_free(graph, graph->atoms);
+  depgraph_free_results(graph);
+  depgraph_free(graph, graph);
+}
+
+DLL_EXPORT_PEDEPS int pedeps_depgraph_add_search_path (pedeps_depgraph_handle graph, const char* path)
+{
+  struct depgraph_folder_struct* folder;
+  uint32_t i;
+  if (depgraph_grow_array(graph, (void**)&(graph->searchfolders), &(graph->searchfoldersallocated), graph->searchfoldercount + 1, sizeof(struct depgraph_folder_struct*)) != 0)
+    return PE_RESULT_OUT_OF_MEMORY;
+  if ((folder = depgraph_folder_create(graph, path)) == NULL)
+    return PE_RESULT_OUT_OF_MEMORY;
+  graph->searchfolders[graph->searchfoldercount++] = folder;
+  //names not found before may be in the new folder
+  for (i = 0; i < graph->atomcount; i++) {
+    if (graph->atoms[i].searchresult == DEPGRAPH_SEARCH_NOT_FOUND)
+      graph->atoms[i].searchresult = DEPGRAPH_SEARCH_PENDING;
+  }
+  return PE_RESULT_SUCCESS;
+}
+
+DLL_EXPORT_PEDEPS void pedeps_depgraph_set_imports_callback (pedeps_depgraph_handle graph, PEdepgraph_get_imports_fn callbackfn, void* callbackdata)
+{
+  graph->importsfn = callbackfn;
+  graph->importsdata = callbackdata;
+}
+
+//get atom for module name, returns PEDEPS_DEPGRAPH_NONE on memory allocation error
+static uint32_t depgraph_get_atom (pedeps_depgraph_handle graph, const char* name)
+{
+  uint32_t atom;
+  if ((atom = depgraph_table_add(graph, &(graph->atomtable), name, 0)) == PEDEPS_DEPGRAPH_NONE)
+    return PEDEPS_DEPGRAPH_NONE;
+  //initialize new atom
+  if (atom == graph->atomcount) {
+    if (depgraph_grow_array(graph, (void**)&(graph->atoms), &(graph->atomsallocated), atom + 1, sizeof(struct depgraph_atom_struct)) != 0)
+      return PEDEPS_DEPGRAPH_NONE;
+    graph->atoms[atom].firstmodule = PEDEPS_DEPGRAPH_NONE;
+    graph->atoms[atom].missingmodule = PEDEPS_DEPGRAPH_NONE;
+    graph->atoms[atom].searchresult = DEPGRAPH_SEARCH_PENDING;
+    graph->atomcount++;
+  }
+  return atom;
+}
+
+//add module (path is NULL for a module that was not found), returns module index or PEDEPS_DEPGRAPH_NONE on memory allocation error
+static uint32_t depgraph_add_module (pedeps_depgraph_handle graph, uint32_t atom, const char* path, uint32_t rootfolder)
+{
+  struct depgraph_module_struct* module;
+  uint32_t pathentry = PEDEPS_DEPGRAPH_NONE;
+  //return existing module
+  if (path) {
+    if ((pathentry = depgraph_table_add(graph, &(graph->pathtable), path, graph->modulecount)) == PEDEPS_DEPGRAPH_NONE)
+      return PEDEPS_DEPGRAPH_NONE;
+    if (graph->pathtable.entries[pathentry].value != graph->modulecount)
+      return graph->pathtable.entries[pathentry].value;
+  } else if (graph->atoms[atom].missingmodule != PEDEPS_DEPGRAPH_NONE) {
+    return graph->atoms[atom].missingmodule;
+  }
+  if (depgraph_grow_array(graph, (void**)&(graph->modules), &(graph->modulesallocated), graph->modulecount + 1, sizeof(struct depgraph_module_struct)) != 0) {
+    //keep path table consistent
+    if (path)
+      graph->pathtable.entries[pathentry].value = PEDEPS_DEPGRAPH_NONE;
+    return PEDEPS_DEPGRAPH_NONE;
+  }
+  module = &(graph->modules[graph->modulecount]);
+  memset(module, 0, sizeof(struct depgraph_module_struct));
+  module->atom = atom;
+  module->path = pathentry;
+  module->rootfolder = rootfolder;
+  if (!path) {
+    module->flags = PEDEPS_DEPGRAPH_MODULE_NOT_FOUND;
+    module->processed = 1;
+    graph->atoms[atom].missingmodule = graph->modulecount;
+  }
+  if (graph->atoms[atom].firstmodule == PEDEPS_DEPGRAPH_NONE)
+    graph->atoms[atom].firstmodule = graph->modulecount;
+  return graph->modulecount++;
+}
+
+DLL_EXPORT_PEDEPS int pedeps_depgraph_add_root (pedeps_depgraph_handle graph, const char* path)
+{
+  const char* name;
+  char* folderpath;
+  size_t len;
+  uint32_t atom;
+  uint32_t rootfolder = PEDEPS_DEPGRAPH_NONE;
+  uint32_t module;
+  if (!depgraph_file_exists(path))
+    return PE_RESULT_OPEN_ERROR;
+  //get file name and folder
+  len = strlen(path);
+  while (len > 0 && !DEPGRAPH_ISPATHSEPARATOR(path[len - 1]))
+    len--;
+  name = path + len;
+  if (graph->flags & PEDEPS_DEPGRAPH_SEARCH_ROOT_FOLDER) {
+    if ((folderpath = (char*)depgraph_malloc(graph, len + 1)) == NULL)
+      return PE_RESULT_OUT_OF_MEMORY;
+    //keep the separator if the root is in the root folder (of a drive)
+    memcpy(folderpath, path, len);
+    folderpath[len] = 0;
+    if (len > 1
+#ifdef _WIN32
+        && !(len == 3 && path[1] == ':')
+#endif
+       )
+      folderpath[len - 1] = 0;
+    if ((rootfolder = depgraph_table_add(graph, &(graph->rootfoldertable), folderpath, 0)) == graph->rootfoldercount) {
+      //take snapshot of new folder
+      if (depgraph_grow_array(graph, (void**)&(graph->rootfolders), &(graph->rootfoldersallocated), rootfolder + 1, sizeof(struct depgraph_folder_struct*)) != 0 || (graph->rootfolders[rootfolder] = depgraph_folder_create(graph, folderpath)) == NULL) {
+        depgraph_free(graph, folderpath);
+        return PE_RESULT_OUT_OF_MEMORY;
+      }
+      graph->rootfoldercount++;
+    }
+    depgraph_free(graph, folderpath);
+    if (rootfolder == PEDEPS_DEPGRAPH_NONE)
+      return PE_RESULT_OUT_OF_MEMORY;
+  }
+  if ((atom = depgraph_get_atom(graph, name)) == PEDEPS_DEPGRAPH_NONE || (module = depgraph_add_module(graph, atom, path, rootfolder)) == PEDEPS_DEPGRAPH_NONE)
+    return PE_RESULT_OUT_OF_MEMORY;
+  graph->modules[module].flags |= PEDEPS_DEPGRAPH_MODULE_ROOT;
+  return PE_RESULT_SUCCESS;
+}
+
+DLL_EXPORT_PEDEPS int pedeps_depgraph_add_import (pedeps_depgraph_handle graph, uint32_t module, const char* modulename)
+{
+  struct depgraph_module_struct* mod;
+  size_t len;
+  if (module >= graph->modulecount)
+    return PE_RESULT_NOT_FOUND;
+  mod = &(graph->modules[module]);
+  len = strlen(modulename) + 1;
+  if (depgraph_grow_array(graph, (void**)&(mod->imports), &(mod->importsallocated), mod->importslen + len, 1) != 0)
+    return PE_RESULT_OUT_OF_MEMORY;
+  memcpy(mod->imports + mod->importslen, modulename, len);
+  mod->importslen += len;
+  mod->importcount++;
+  return PE_RESULT_SUCCESS;
+}
+
+//find the module a module name refers to, returns PEDEPS_DEPGRAPH_NONE on memory allocation error
+static uint32_t depgraph_resolve (pedeps_depgraph_handle graph, uint32_t module, const char* modulename)
+{
+  struct depgraph_atom_struct* atom;
+  const char* p;
+  char* path = NULL;
+  uint32_t atomindex;
+  uint32_t rootfolder = graph->modules[module].rootfolder;
+  uint32_t i;
+  //get file name from module name
+  for (p = modulename + strlen(modulename); p > modulename && !DEPGRAPH_ISPATHSEPARATOR(*(p - 1)); p--)
+    ;
+  if ((atomindex = depgraph_get_atom(graph, p)) == PEDEPS_DEPGRAPH_NONE)
+    return PEDEPS_DEPGRAPH_NONE;
+  atom = &(graph->atoms[atomindex]);
+  if (p != modulename) {
+    //use module name as is if it contains a path
+    if (depgraph_file_exists(modulename) && (path = depgraph_strdup(graph, modulename)) == NULL)
+      return PEDEPS_DEPGRAPH_NONE;
+  } else {
+    //check current folder
+    if ((graph->flags & PEDEPS_DEPGRAPH_SEARCH_CURRENT_FOLDER) && graph->currentfolder)
+      path = depgraph_folder_get_path(graph, graph->currentfolder, modulename);
+    //check folder of root
+    if (!path && rootfolder != PEDEPS_DEPGRAPH_NONE)
+      path = depgraph_folder_get_path(graph, graph->rootfolders[rootfolder], modulename);
+    //check search path (result is remembered, including when not found)
+    if (!path && atom->searchresult != DEPGRAPH_SEARCH_NOT_FOUND) {
+      if (atom->searchresult == DEPGRAPH_SEARCH_PENDING) {
+        atom->searchresult = DEPGRAPH_SEARCH_NOT_FOUND;
+        for (i = 0; i < graph->searchfoldercount; i++) {
+          if (depgraph_table_find(&(graph->searchfolders[i]->files), modulename) != PEDEPS_DEPGRAPH_NONE) {
+            atom->searchresult = i + DEPGRAPH_SEARCH_FOUND;
+            break;
+          }
+        }
+      }
+      if (atom->searchresult != DEPGRAPH_SEARCH_NOT_FOUND)
+        path = depgraph_folder_get_path(graph, graph->searchfolders[atom->searchresult - DEPGRAPH_SEARCH_FOUND], modulename);
+    }
+  }
+  i = depgraph_add_module(graph, atomindex, path, rootfolder);
+  depgraph_free(graph, path);
+  return i;
+}
+
+//add dependency (only once), returns non-zero on memory allocation error
+static int depgraph_add_dependency (pedeps_depgraph_handle graph, uint32_t module, uint32_t dependency)
+{
+  struct depgraph_module_struct* mod = &(graph->modules[module]);
+  uint32_t i;
+  for (i = 0; i < mod->dependencycount; i++) {
+    if (mod->dependencies[i] == dependency)
+      return 0;
+  }
+  if (depgraph_grow_array(graph, (void**)&(mod->dependencies), &(mod->dependenciesallocated), mod->dependencycount + 1, sizeof(uint32_t)) != 0)
+    return -1;
+  mod->dependencies[mod->dependencycount++] = dependency;
+  return 0;
+}
+
+struct depgraph_scan_struct {
+  pedeps_depgraph_handle graph;
+  const uint32_t* modules;
+};
+
+//store the imported module names of a parsed file (called from multiple threads for different modules)
+static int depgraph_scan_callback (const struct pefile_scan_result_struct* result, void* callbackdata)
+{
+  struct depgraph_scan_struct* scan = (struct depgraph_scan_struct*)callbackdata;
+  uint32_t module = scan->modules[result->index];
+  uint32_t i;
+  if (result->status != PE_RESULT_SUCCESS) {
+    scan->graph->modules[module].flags |= PEDEPS_DEPGRAPH_MODULE_ERROR;
+    return 0;
+  }
+  scan->graph->modules[module].flags |= PEDEPS_DEPGRAPH_MODULE_PARSED;
+  for (i = 0; i < result->imports->modulecount; i++) {
+    if (pedeps_depgraph_add_import(scan->graph, module, result->imports->strings + result->imports->modules[i].name) != PE_RESULT_SUCCESS)
+      return PE_RESULT_OUT_OF_MEMORY;
+  }
+  return 0;
+}
+
+//build compressed adjacency arrays (dependencies and dependents)
+static int depgraph_build_adjacency (pedeps_depgraph_handle graph)
+{
+  uint32_t* counts;
+  uint32_t i;
+  uint32_t j;
+  uint32_t total = 0;
+  if ((graph->dependencystart = (uint32_t*)depgraph_malloc(graph, (graph->modulecount + 1) * sizeof(uint32_t))) == NULL || (graph->dependentstart = (uint32_t*)depgraph_malloc(graph, (graph->modulecount + 1) * sizeof(uint32_t))) == NULL)
+    return PE_RESULT_OUT_OF_MEMORY;
+  for (i = 0; i < graph->modulecount; i++)
+    total += graph->modules[i].dependencycount;
+  if ((graph->dependencylist = (uint32_t*)depgraph_malloc(graph, (total + 1) * sizeof(uint32_t))) == NULL || (graph->dependentlist = (uint32_t*)depgraph_malloc(graph, (total + 1) * sizeof(uint32_t))) == NULL)
+    return PE_RESULT_OUT_OF_MEMORY;
+  //dependencies in import order
+  memset(graph->dependentstart, 0, (graph->modulecount + 1) * sizeof(uint32_t));
+  total = 0;
+  for (i = 0; i < graph->modulecount; i++) {
+    graph->dependencystart[i] = total;
+    for (j = 0; j < graph->modules[i].dependencycount; j++) {
+      graph->dependencylist[total++] = graph->modules[i].dependencies[j];
+      graph->dependentstart[graph->modules[i].dependencies[j] + 1]++;
+    }
+  }
+  graph->dependencystart[graph->modulecount] = total;
+  //dependents in module order
+  for (i = 0; i < graph->modulecount; i++)
+    graph->dependentstart[i + 1] += graph->dependentstart[i];
+  if ((counts = (uint32_t*)depgraph_malloc(graph, (graph->modulecount + 1) * sizeof(uint32_t))) == NULL)
+    return PE_RESULT_OUT_OF_MEMORY;
+  memcpy(counts, graph->dependentstart, (graph->modulecount + 1) * sizeof(uint32_t));
+  for (i = 0; i < graph->modulecount; i++) {
+    for (j = graph->dependencystart[i]; j < graph->dependencystart[i + 1]; j++)
+      graph->dependentlist[counts[graph->dependencylist[j]]++] = i;
+  }
+  depgraph_free(graph, counts);
+  return PE_RESULT_SUCCESS;
+}
+
+//determine order (dependencies first) and cycles using Tarjan's strongly connected components algorithm (without recursion)
+static int depgraph_build_order (pedeps_depgraph_handle graph)
+{
+  uint32_t* index;
+  uint32_t* lowlink;
+  uint32_t* stack;
+  uint32_t* callstack;
+  uint32_t* edgepos;
+  uint32_t stacklen = 0;
+  uint32_t calllen;
+  uint32_t ordercount = 0;
+  uint32_t nextindex = 1;
+  uint32_t root;
+  uint32_t v;
+  uint32_t w;
+  uint32_t i;
+  uint32_t cycle;
+  int result = PE_RESULT_SUCCESS;
+  index = (uint32_t*)depgraph_malloc(graph, (graph->modulecount + 1) * sizeof(uint32_t));
+  lowlink = (uint32_t*)depgraph_malloc(graph, (graph->modulecount + 1) * sizeof(uint32_t));
+  stack = (uint32_t*)depgraph_malloc(graph, (graph->modulecount + 1) * sizeof(uint32_t));
+  callstack = (uint32_t*)depgraph_malloc(graph, (graph->modulecount + 1) * sizeof(uint32_t));
+  edgepos = (uint32_t*)depgraph_malloc(graph, (graph->modulecount + 1) * sizeof(uint32_t));
+  graph->order = (uint32_t*)depgraph_malloc(graph, (graph->modulecount + 1) * sizeof(uint32_t));
+  if (!index || !lowlink || !stack || !callstack || !edgepos || !graph->order) {
+    result = PE_RESULT_OUT_OF_MEMORY;
+  } else {
+    //index 0 means not visited yet, lowlink 0 means no longer on the stack
+    memset(index, 0, graph->modulecount * sizeof(uint32_t));
+    for (root = 0; root < graph->modulecount; root++) {
+      if (index[root])
+        continue;
+      calllen = 0;
+      callstack[calllen++] = root;
+      index[root] = lowlink[root] = nextindex++;
+      edgepos[root] = graph->dependencystart[root];
+      stack[stacklen++] = root;
+      while (calllen > 0) {
+        v = callstack[calllen - 1];
+        if (edgepos[v] < graph->dependencystart[v + 1]) {
+          //visit next dependency
+          w = graph->dependencylist[edgepos[v]++];
+          if (!index[w]) {
+            index[w] = lowlink[w] = nextindex++;
+            edgepos[w] = graph->dependencystart[w];
+            stack[stacklen++] = w;
+            callstack[calllen++] = w;
+          } else if (lowlink[w] && index[w] < lowlink[v]) {
+            lowlink[v] = index[w];
+          }
+        } else {
+          //all dependencies visited
+          calllen--;
+          if (calllen > 0 && lowlink[v] && lowlink[v] < lowlink[callstack[calllen - 1]])
+            lowlink[callstack[calllen - 1]] = lowlink[v];
+          if (lowlink[v] == index[v]) {
+            //v is the root of a strongly connected component, which is a cycle if it has more than one module or if it imports itself
+            i = stacklen;
+            while (stack[--i] != v)
+              ;
+            cycle = 0;
+            if (stacklen - i > 1) {
+              cycle = ++graph->cyclecount;
+            } else {
+              for (w = graph->dependencystart[v]; w < graph->dependencystart[v + 1]; w++) {
+                if (graph->dependencylist[w] == v) {
+                  cycle = ++graph->cyclecount;
+                  break;
+                }
+              }
+            }
+            //members of the component are adjacent in the order
+            while (stacklen > i) {
+              w = stack[--stacklen];
+              lowlink[w] = 0;
+              graph->modules[w].cycle = cycle;
+              if (cycle)
+                graph->modules[w].flags |= PEDEPS_DEPGRAPH_MODULE_IN_CYCLE;
+              else
+                graph->modules[w].flags &= ~PEDEPS_DEPGRAPH_MODULE_IN_CYCLE;
+              graph->order[ordercount++] = w;
+            }
+          }
+        }
+      }
+    }
+  }
+  depgraph_free(graph, index);
+  depgraph_free(graph, lowlink);
+  depgraph_free(graph, stack);
+  depgraph_free(graph, callstack);
+  depgraph_free(graph, edgepos);
+  return result;
+}
+
+DLL_EXPORT_PEDEPS int pedeps_depgraph_build (pedeps_depgraph_handle graph, unsigned int nthreads)
+{
+  struct depgraph_scan_struct scan;
+  const char** paths = NULL;
+  size_t pathsallocated = 0;
+  uint32_t* scanmodules = NULL;
+  size_t scanmodulesallocated = 0;
+  uint32_t scancount;
+  uint32_t levelcount;
+  uint32_t levelstart;
+  uint32_t i;
+  uint32_t dependency;
+  size_t pos;
+  int result = PE_RESULT_SUCCESS;
+  depgraph_free_results(graph);
+  //take snapshot of the current folder
+  if ((graph->flags & PEDEPS_DEPGRAPH_SEARCH_CURRENT_FOLDER) && !graph->currentfolder) {
+    if ((graph->currentfolder = depgraph_folder_create(graph, "")) == NULL)
+      return PE_RESULT_OUT_OF_MEMORY;
+  }
+  //process one level of modules at a time, modules added while resolving the imports of a level form the next level
+  levelstart = 0;
+  while (result == PE_RESULT_SUCCESS) {
+    levelcount = graph->modulecount;
+    scancount = 0;
+    for (i = levelstart; i < levelcount; i++) {
+      if (graph->modules[i].processed || ((graph->flags & PEDEPS_DEPGRAPH_DIRECT_ONLY) && !(graph->modules[i].flags & PEDEPS_DEPGRAPH_MODULE_ROOT)))
+        continue;
+      //let the application provide the imported module names (e.g. from a cache) or parse the file
+      if (graph->importsfn && (graph->importsfn)(graph, i, graph->pathtable.names + graph->pathtable.entries[graph->modules[i].path].nameoffset, graph->importsdata)) {
+        graph->modules[i].flags |= PEDEPS_DEPGRAPH_MODULE_PROVIDED;
+        continue;
+      }
+      //discard any imports added by the callback function before it decided to have the file parsed
+      graph->modules[i].importslen = 0;
+      graph->modules[i].importcount = 0;
+      if (depgraph_grow_array(graph, (void**)&paths, &pathsallocated, scancount + 1, sizeof(const char*)) != 0 || depgraph_grow_array(graph, (void**)&scanmodules, &scanmodulesallocated, scancount + 1, sizeof(uint32_t)) != 0) {
+        result = PE_RESULT_OUT_OF_MEMORY;
+        break;
+      }
+      scanmodules[scancount++] = i;
+    }
+    //get the path of each file after all modules are known as the path table may move while adding modules
+    for (i = 0; i < scancount; i++)
+      paths[i] = graph->pathtable.names + graph->pathtable.entries[graph->modules[scanmodules[i]].path].nameoffset;
+    if (result == PE_RESULT_SUCCESS && scancount > 0) {
+      scan.graph = graph;
+      scan.modules = scanmodules;
+      result = scan_batch(paths, scancount, nthreads, 0, depgraph_scan_callback, &scan);
+    }
+    //resolve imported module names in a fixed order so the result doesn't depend on the order in which files were parsed
+    for (i = levelstart; i < levelcount && result == PE_RESULT_SUCCESS; i++) {
+      if (graph->modules[i].processed || ((graph->flags & PEDEPS_DEPGRAPH_DIRECT_ONLY) && !(graph->modules[i].flags & PEDEPS_DEPGRAPH_MODULE_ROOT)))
+        continue;
+      for (pos = 0; pos < graph->modules[i].importslen; pos += strlen(graph->modules[i].imports + pos) + 1) {
+        if ((dependency = depgraph_resolve(graph, i, graph->modules[i].imports + pos)) == PEDEPS_DEPGRAPH_NONE || depgraph_add_dependency(graph, i, dependency) != 0) {
+          result = PE_RESULT_OUT_OF_MEMORY;
+          break;
+        }
+      }
+      graph->modules[i].processed = 1;
+      depgraph_free(graph, graph->modules[i].imports);
+      graph->modules[i].imports = NULL;
+      graph->modules[i].importslen = 0;
+      graph->modules[i].importsallocated = 0;
+    }
+    if (levelcount == graph->modulecount)
+      break;
+    levelstart = levelcount;
+  }
+  depgraph_free(graph, paths);
+  depgraph_free(graph, scanmodules);
+  if (result != PE_RESULT_SUCCESS)
+    return result;
+  //build adjacency arrays, order and cycles
+  graph->builtcount = graph->modulecount;
+  if ((result = depgraph_build_adjacency(graph)) != PE_RESULT_SUCCESS || (result = depgraph_build_order(graph)) != PE_RESULT_SUCCESS) {
+    depgraph_free_results(graph);
+    return result;
+  }
+  return PE_RESULT_SUCCESS;
+}
+
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_get_module_count (pedeps_depgraph_handle graph)
+{
+  return graph->modulecount;
+}
+
+DLL_EXPORT_PEDEPS const char* pedeps_depgraph_get_module_name (pedeps_depgraph_handle graph, uint32_t module)
+{
+  if (module >= graph->modulecount)
+    return NULL;
+  return depgraph_table_name(&(graph->atomtable), graph->modules[module].atom);
+}
+
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_get_module_atom (pedeps_depgraph_handle graph, uint32_t module)
+{
+  if (module >= graph->modulecount)
+    return PEDEPS_DEPGRAPH_NONE;
+  return graph->modules[module].atom;
+}
+
+DLL_EXPORT_PEDEPS const char* pedeps_depgraph_get_module_path (pedeps_depgraph_handle graph, uint32_t module)
+{
+  if (module >= graph->modulecount || graph->modules[module].path == PEDEPS_DEPGRAPH_NONE)
+    return NULL;
+  return depgraph_table_name(&(graph->pathtable), graph->modules[module].path);
+}
+
+DLL_EXPORT_PEDEPS unsigned int pedeps_depgraph_get_module_flags (pedeps_depgraph_handle graph, uint32_t module)
+{
+  if (module >= graph->modulecount)
+    return 0;
+  return graph->modules[module].flags;
+}
+
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_get_dependencies (pedeps_depgraph_handle graph, uint32_t module, const uint32_t** dependencies)
+{
+  if (!graph->dependencystart || module >= graph->builtcount) {
+    *dependencies = NULL;
+    return 0;
+  }
+  *dependencies = graph->dependencylist + graph->dependencystart[module];
+  return graph->dependencystart[module + 1] - graph->dependencystart[module];
+}
+
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_get_dependents (pedeps_depgraph_handle graph, uint32_t module, const uint32_t** dependents)
+{
+  if (!graph->dependentstart || module >= graph->builtcount) {
+    *dependents = NULL;
+    return 0;
+  }
+  *dependents = graph->dependentlist + graph->dependentstart[module];
+  return graph->dependentstart[module + 1] - graph->dependentstart[module];
+}
+
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_get_order (pedeps_depgraph_handle graph, const uint32_t** order)
+{
+  if (!graph->order) {
+    *order = NULL;
+    return 0;
+  }
+  *order = graph->order;
+  return graph->builtcount;
+}
+
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_get_cycle (pedeps_depgraph_handle graph, uint32_t module)
+{
+  if (!graph->order || module >= graph->builtcount)
+    return 0;
+  return graph->modules[module].cycle;
+}
+
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_get_cycle_count (pedeps_depgraph_handle graph)
+{
+  return graph->cyclecount;
+}
+
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_find_module (pedeps_depgraph_handle graph, const char* modulename)
+{
+  uint32_t atom;
+  if ((atom = depgraph_table_find(&(graph->atomtable), modulename)) == PEDEPS_DEPGRAPH_NONE)
+    return PEDEPS_DEPGRAPH_NONE;
+  return graph->atoms[atom].firstmodule;
 }
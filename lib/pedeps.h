@@ -29,6 +29,7 @@ THE SOFTWARE.
 #define INCLUDED_PE_IO_H
 
 #include <inttypes.h>
+#include <stddef.h>
 #include <wchar.h>
 
 /*! \cond PRIVATE */
@@ -89,6 +90,8 @@ typedef struct pefile_struct* pefile_handle;
 #define PE_RESULT_NOT_PE        5       /**< not a PE file */
 #define PE_RESULT_NOT_PE_LE     6       /**< not a little endian PE file */
 #define PE_RESULT_WRONG_IMAGE   7       /**< invalid file image type */
+#define PE_RESULT_INVALID_RVA   8       /**< relative virtual address not in image */
+#define PE_RESULT_NOT_FOUND     9       /**< symbol not found */
 /*! @} */
 
 /*! \brief get text message describing the status code
@@ -98,7 +101,55 @@ typedef struct pefile_struct* pefile_handle;
  */
 DLL_EXPORT_PEDEPS const char* pefile_status_message (int statuscode);
 
+/*! \brief function type used by pedeps_set_allocator() for allocating memory
+ * \param  size                  number of bytes to allocate
+ * \param  userdata              custom data passed to pedeps_set_allocator()
+ * \return pointer to allocated memory or NULL on error
+ * \sa     pedeps_set_allocator()
+ */
+typedef void* (*PEmem_malloc_fn) (size_t size, void* userdata);
+
+/*! \brief function type used by pedeps_set_allocator() for resizing allocated memory
+ * \param  ptr                   pointer to memory allocated before (or NULL)
+ * \param  size                  new number of bytes
+ * \param  userdata              custom data passed to pedeps_set_allocator()
+ * \return pointer to reallocated memory or NULL on error
+ * \sa     pedeps_set_allocator()
+ */
+typedef void* (*PEmem_realloc_fn) (void* ptr, size_t size, void* userdata);
+
+/*! \brief function type used by pedeps_set_allocator() for freeing allocated memory
+ * \param  ptr                   pointer to memory allocated before (or NULL)
+ * \param  userdata              custom data passed to pedeps_set_allocator()
+ * \sa     pedeps_set_allocator()
+ */
+typedef void (*PEmem_free_fn) (void* ptr, void* userdata);
+
+/*! \brief set the memory allocation functions used by handles created afterwards
+ * \details Each handle keeps the functions it was created with, so changing them
+ *          does not affect existing handles. Must not be called while other
+ *          threads are creating handles.
+ * \param  malloc_fn             custom function for allocating memory (NULL to restore the default functions)
+ * \param  realloc_fn            custom function for resizing allocated memory
+ * \param  free_fn               custom function for freeing allocated memory
+ * \param  userdata              custom data passed to the functions
+ * \sa     pefile_create()
+ * \sa     pefile_create_with_allocator()
+ * \sa     PEmem_malloc_fn
+ * \sa     PEmem_realloc_fn
+ * \sa     PEmem_free_fn
+ */
+DLL_EXPORT_PEDEPS void pedeps_set_allocator (PEmem_malloc_fn malloc_fn, PEmem_realloc_fn realloc_fn, PEmem_free_fn free_fn, void* userdata);
+
 /*! \brief create handle for use with the pedeps library
+ * \details Once a file is opened the functions that query it (like listing
+ *          imports, exports and resources, looking up exports and reading data)
+ *          may be called from multiple threads at the same time using the same
+ *          handle. Opening, closing and destroying the handle and configuring
+ *          the cache with pefile_set_cache() must not happen while other
+ *          threads are using it. When using pefile_open_custom() reads are
+ *          serialized as they depend on the file position, use
+ *          pefile_open_custom_pread() to avoid this.
  * \return handle
  * \sa     pefile_handle
  * \sa     pefile_open_custom()
@@ -110,6 +161,20 @@ DLL_EXPORT_PEDEPS const char* pefile_status_message (int statuscode);
  */
 DLL_EXPORT_PEDEPS pefile_handle pefile_create ();
 
+/*! \brief create handle for use with the pedeps library using custom memory allocation functions
+ * \details All memory used by the handle, including the handle itself, is
+ *          allocated with the specified functions.
+ * \param  malloc_fn             custom function for allocating memory (NULL to use the functions set with pedeps_set_allocator())
+ * \param  realloc_fn            custom function for resizing allocated memory
+ * \param  free_fn               custom function for freeing allocated memory
+ * \param  userdata              custom data passed to the functions
+ * \return handle
+ * \sa     pefile_create()
+ * \sa     pedeps_set_allocator()
+ * \sa     pefile_destroy()
+ */
+DLL_EXPORT_PEDEPS pefile_handle pefile_create_with_allocator (PEmem_malloc_fn malloc_fn, PEmem_realloc_fn realloc_fn, PEmem_free_fn free_fn, void* userdata);
+
 /*! \brief function type used by pefile_open_custom() for reading data from file
  * \param  iohandle              I/O handle data passed to pefile_open_custom()
  * \param  buf                   buffer where data will be read to
@@ -153,6 +218,18 @@ typedef int (*PEio_seek_fn) (void* iohandle, uint64_t pos);
  */
 typedef void (*PEio_close_fn) (void* iohandle);
 
+/*! \brief function type used by pefile_open_custom_pread() for reading data from a specific file position
+ * \details Unlike PEio_read_fn the file position must not be changed by this function.
+ * \param  iohandle              I/O handle data passed to pefile_open_custom_pread()
+ * \param  pos                   file position to read data from
+ * \param  buf                   buffer where data will be read to
+ * \param  buflen                size of \b buf
+ * \return number of bytes read
+ * \sa     pefile_open_custom_pread()
+ * \sa     PEio_close_fn
+ */
+typedef uint64_t (*PEio_pread_fn) (void* iohandle, uint64_t pos, void* buf, uint64_t buflen);
+
 /*! \brief function type used by pefile_open_custom() for positioning within file
  * \param  pe_file               handle as returned by pefile_create()
  * \param  iohandle              I/O handle data to be passed passed to the custom functions
@@ -171,6 +248,22 @@ typedef void (*PEio_close_fn) (void* iohandle);
  */
 DLL_EXPORT_PEDEPS int pefile_open_custom (pefile_handle pe_file, void* iohandle, PEio_read_fn read_fn, PEio_tell_fn tell_fn, PEio_seek_fn seek_fn, PEio_close_fn close_fn);
 
+/*! \brief open file using custom positional read function
+ * \details Each read specifies the file position, so no seek and tell functions are needed.
+ * \param  pe_file               handle as returned by pefile_create()
+ * \param  iohandle              I/O handle data to be passed passed to the custom functions
+ * \param  pread_fn              custom function for reading data from a specific file position
+ * \param  close_fn              custom function for closing file (NULL to leave open)
+ * \return 0 on success or one of the PE_RESULT_* status result codes
+ * \sa     pefile_create()
+ * \sa     pefile_open_custom()
+ * \sa     pefile_open_file()
+ * \sa     PEio_pread_fn
+ * \sa     PEio_close_fn
+ * \sa     PE_RESULT_*
+ */
+DLL_EXPORT_PEDEPS int pefile_open_custom_pread (pefile_handle pe_file, void* iohandle, PEio_pread_fn pread_fn, PEio_close_fn close_fn);
+
 /*! \brief function type used by pefile_open_custom() for positioning within file
  * \param  pe_file               handle as returned by pefile_create()
  * \param  filename              path of file to open
@@ -181,6 +274,33 @@ DLL_EXPORT_PEDEPS int pefile_open_custom (pefile_handle pe_file, void* iohandle,
  */
 DLL_EXPORT_PEDEPS int pefile_open_file (pefile_handle pe_file, const char* filename);
 
+/*! \brief open file by mapping it in memory (read-only)
+ * \details Instead of reading data with I/O functions the whole file is mapped in memory
+ *          and data is accessed directly through this mapping.
+ * \param  pe_file               handle as returned by pefile_create()
+ * \param  filename              path of file to open
+ * \return 0 on success or one of the PE_RESULT_* status result codes
+ * \sa     pefile_create()
+ * \sa     pefile_open_file()
+ * \sa     pefile_close()
+ * \sa     PE_RESULT_*
+ */
+DLL_EXPORT_PEDEPS int pefile_open_mmap (pefile_handle pe_file, const char* filename);
+
+/*! \brief open file image from a buffer in memory
+ * \details The data is parsed in place, it is not copied.
+ *          The buffer must remain valid and unchanged until pefile_close() is called.
+ * \param  pe_file               handle as returned by pefile_create()
+ * \param  data                  pointer to the PE file image
+ * \param  datalen               size of \b data (in bytes)
+ * \return 0 on success or one of the PE_RESULT_* status result codes
+ * \sa     pefile_create()
+ * \sa     pefile_open_mmap()
+ * \sa     pefile_close()
+ * \sa     PE_RESULT_*
+ */
+DLL_EXPORT_PEDEPS int pefile_open_memory (pefile_handle pe_file, const void* data, size_t datalen);
+
 /*! \brief function type used by pefile_read() for reading data from file
  * \param  buf                   buffer containing data
  * \param  buflen                size of buffer (in bytes)
@@ -223,6 +343,31 @@ DLL_EXPORT_PEDEPS void pefile_destroy (pefile_handle pe_file);
  */
 DLL_EXPORT_PEDEPS uint64_t pefile_read (pefile_handle pe_file, uint64_t filepos, uint64_t datalen, void* buf, size_t buflen, pefile_readdata_fn callbackfn, void* callbackdata);
 
+/*! \brief configure block cache used between the parser and the custom I/O functions
+ * \details When enabled data read with the I/O functions is cached in blocks of
+ *          \b blocksize bytes, so repeated and neighbouring small reads are served
+ *          from memory. The cache is not used for files opened with pefile_open_mmap()
+ *          or pefile_open_memory(). The setting is kept when the handle is reused
+ *          for other files, cached data is discarded when a file is closed.
+ * \param  pe_file               handle as returned by pefile_create()
+ * \param  blocksize             size of each cache block (in bytes)
+ * \param  blockcount            number of blocks to cache (0 to disable caching)
+ * \return 0 on success or one of the PE_RESULT_* status result codes
+ * \sa     pefile_create()
+ * \sa     pefile_open_custom()
+ * \sa     pefile_open_custom_pread()
+ * \sa     pefile_get_cache_stats()
+ */
+DLL_EXPORT_PEDEPS int pefile_set_cache (pefile_handle pe_file, size_t blocksize, size_t blockcount);
+
+/*! \brief get block cache statistics
+ * \param  pe_file               handle as returned by pefile_create()
+ * \param  hits                  pointer that will receive the number of block lookups served from the cache (or NULL)
+ * \param  misses                pointer that will receive the number of blocks read from file (or NULL)
+ * \sa     pefile_set_cache()
+ */
+DLL_EXPORT_PEDEPS void pefile_get_cache_stats (pefile_handle pe_file, uint64_t* hits, uint64_t* misses);
+
 /*! \brief PE file format identifiers as returned by pefile_get_signature()
  * \sa     pefile_get_signature()
  * \name   PE_SIGNATURE_*
@@ -333,6 +478,55 @@ DLL_EXPORT_PEDEPS int pefile_is_stripped (pefile_handle pe_file);
  */
 DLL_EXPORT_PEDEPS uint64_t pefile_get_image_base_address (pefile_handle pe_file);
 
+/*! \brief translate relative virtual address to file position
+ * \details Uses an index of the sections sorted by address built when the file
+ *          is opened, so lookups take logarithmic time in the number of sections.
+ * \param  pe_file               handle as returned by pefile_create()
+ * \param  rva                   relative virtual address
+ * \param  offset                pointer that will receive the position in the file
+ * \return 0 on success or one of the PE_RESULT_* status result codes (PE_RESULT_INVALID_RVA if the address is not backed by file data)
+ * \sa     pefile_create()
+ * \sa     pefile_read()
+ * \sa     PE_RESULT_*
+ */
+DLL_EXPORT_PEDEPS int pefile_rva_to_offset (pefile_handle pe_file, uint32_t rva, uint64_t* offset);
+
+/*! \brief information about a PE file as returned by pefile_probe_file() and pefile_probe_memory()
+ * \sa     pefile_probe_file()
+ * \sa     pefile_probe_memory()
+ */
+struct pefile_probe_info_struct {
+  uint16_t signature;                   /**< file format identifier (see PE_SIGNATURE_*) */
+  uint16_t machine;                     /**< machine architecture identifier (see PE_MACHINE_*) */
+  uint16_t subsystem;                   /**< OS subsystem identifier (see PE_SUBSYSTEM_*) */
+  uint16_t characteristics;             /**< COFF characteristics (see PE_CHARACTERISTIC_*) */
+  int isdll;                            /**< non-zero if the file is a DLL */
+  uint64_t imagebase;                   /**< preferred base address */
+  uint16_t sectioncount;                /**< number of sections */
+  uint32_t datadirectories;             /**< bit mask of data directories present (bit n set for data directory n, see PE_DATA_DIR_IDX_*) */
+};
+
+/*! \brief get basic information about a PE file without fully opening it
+ * \details Only reads the first 4 KiB of the file (and the PE headers if they
+ *          are located beyond that), and does not allocate any memory.
+ * \param  filename              path of file to probe
+ * \param  info                  structure that will receive the information
+ * \return 0 on success or one of the PE_RESULT_* status result codes
+ * \sa     pefile_probe_memory()
+ * \sa     struct pefile_probe_info_struct
+ */
+DLL_EXPORT_PEDEPS int pefile_probe_file (const char* filename, struct pefile_probe_info_struct* info);
+
+/*! \brief get basic information about a PE file in memory without fully opening it
+ * \param  data                  pointer to the beginning of the PE file (at least the headers)
+ * \param  datalen               size of \b data (in bytes)
+ * \param  info                  structure that will receive the information
+ * \return 0 on success or one of the PE_RESULT_* status result codes
+ * \sa     pefile_probe_file()
+ * \sa     struct pefile_probe_info_struct
+ */
+DLL_EXPORT_PEDEPS int pefile_probe_memory (const void* data, size_t datalen, struct pefile_probe_info_struct* info);
+
 /*! \brief callback function called by pefile_list_imports() for each imported symbol
  * \param  modulename            name of module file where symbol is imported from
  * \param  functionname          name of imported symbol
@@ -352,6 +546,83 @@ typedef int (*PEfile_list_imports_fn) (const char* modulename, const char* funct
  */
 DLL_EXPORT_PEDEPS int pefile_list_imports (pefile_handle pe_file, PEfile_list_imports_fn callbackfn, void* callbackdata);
 
+/*! \brief callback function called by pefile_list_imports_v2() for each imported symbol
+ * \details The strings are zero-terminated and only valid during the callback, they point
+ *          directly into the file data in memory or into a buffer that is reused for the next symbol.
+ * \param  modulename            name of module file where symbol is imported from
+ * \param  modulenamelen         length of \b modulename
+ * \param  functionname          name of imported symbol or NULL if imported by ordinal
+ * \param  functionnamelen       length of \b functionname
+ * \param  ordinal               ordinal number of imported symbol (only if \b functionname is NULL)
+ * \param  callbackdata          callback data passed via pefile_list_imports_v2()
+ * \return 0 to continue processing, non-zero to abort
+ * \sa     pefile_list_imports_v2()
+ */
+typedef int (*PEfile_list_imports_v2_fn) (const char* modulename, size_t modulenamelen, const char* functionname, size_t functionnamelen, uint16_t ordinal, void* callbackdata);
+
+/*! \brief iterate through all imported symbols without allocating memory for each string
+ * \param  pe_file               handle as returned by pefile_create()
+ * \param  callbackfn            callback function called for each imported symbol
+ * \param  callbackdata          callback data passed to \b callbackfn
+ * \return 0 on success or one of the PE_RESULT_* status result codes
+ * \sa     pefile_create()
+ * \sa     pefile_list_imports()
+ * \sa     PEfile_list_imports_v2_fn
+ */
+DLL_EXPORT_PEDEPS int pefile_list_imports_v2 (pefile_handle pe_file, PEfile_list_imports_v2_fn callbackfn, void* callbackdata);
+
+/*! \brief module entry in import table returned by pefile_get_imports()
+ * \sa     pefile_get_imports()
+ * \sa     struct pefile_imports_struct
+ */
+struct pefile_import_module_struct {
+  uint32_t name;                        /**< offset of zero-terminated module name in string pool */
+  uint32_t namelen;                     /**< length of module name */
+  uint32_t firstimport;                 /**< index of first import record of this module */
+  uint32_t importcount;                 /**< number of import records of this module */
+};
+
+/*! \brief import record in import table returned by pefile_get_imports()
+ * \sa     pefile_get_imports()
+ * \sa     struct pefile_imports_struct
+ */
+struct pefile_import_struct {
+  uint32_t module;                      /**< index of module in module array */
+  uint32_t name;                        /**< offset of zero-terminated symbol name in string pool (empty string if imported by ordinal) */
+  uint32_t namelen;                     /**< length of symbol name */
+  uint32_t iatrva;                      /**< relative virtual address of Import Address Table entry */
+  uint16_t hint;                        /**< index hint into export name table of module (only if imported by name) */
+  uint16_t ordinal;                     /**< ordinal number (only if imported by ordinal) */
+  uint8_t byordinal;                    /**< non-zero if imported by ordinal */
+};
+
+/*! \brief import table returned by pefile_get_imports()
+ * \sa     pefile_get_imports()
+ */
+struct pefile_imports_struct {
+  uint32_t modulecount;                 /**< number of modules */
+  uint32_t importcount;                 /**< number of import records */
+  const struct pefile_import_module_struct* modules;  /**< array of modules */
+  const struct pefile_import_struct* imports;         /**< array of import records, grouped by module */
+  const char* strings;                  /**< string pool */
+  size_t stringslen;                    /**< size of string pool (in bytes) */
+};
+
+/*! \brief get all imported symbols as one table
+ * \details The table is stored in a single block of memory owned by the handle,
+ *          which stays valid until the file is closed. Subsequent calls return
+ *          the same table without processing the file again.
+ *          No table is returned if any part of the import directory can't be read.
+ *          Must not be called from within a callback function of the same handle.
+ * \param  pe_file               handle as returned by pefile_create()
+ * \param  imports               pointer that will receive the import table
+ * \return 0 on success or one of the PE_RESULT_* status result codes
+ * \sa     pefile_create()
+ * \sa     pefile_list_imports_v2()
+ * \sa     struct pefile_imports_struct
+ */
+DLL_EXPORT_PEDEPS int pefile_get_imports (pefile_handle pe_file, const struct pefile_imports_struct** imports);
+
 /*! \brief callback function called by PEfile_list_exports_fn() for each exported symbol
  * \param  modulename            name of module file (should match the file being processed)
  * \param  functionname          name of exported symbol
@@ -375,6 +646,114 @@ typedef int (*PEfile_list_exports_fn) (const char* modulename, const char* funct
  */
 DLL_EXPORT_PEDEPS int pefile_list_exports (pefile_handle pe_file, PEfile_list_exports_fn callbackfn, void* callbackdata);
 
+/*! \brief callback function called by pefile_list_exports_v2() for each exported symbol
+ * \details The strings are zero-terminated and only valid during the callback, they point
+ *          directly into the file data in memory or into a buffer that is reused for the next symbol.
+ * \param  modulename               name of module file (should match the file being processed)
+ * \param  modulenamelen            length of \b modulename
+ * \param  functionname             name of exported symbol or NULL if only exported by ordinal
+ * \param  functionnamelen          length of \b functionname
+ * \param  ordinal                  ordinal number of exported symbol
+ * \param  isdata                   0 for function, non-zero for data variable
+ * \param  functionforwardername    name of forwarder function (notation: module.function) or NULL of not forwarded
+ * \param  functionforwardernamelen length of \b functionforwardername
+ * \param  callbackdata             callback data passed via pefile_list_exports_v2()
+ * \return 0 to continue processing, non-zero to abort
+ * \sa     pefile_list_exports_v2()
+ */
+typedef int (*PEfile_list_exports_v2_fn) (const char* modulename, size_t modulenamelen, const char* functionname, size_t functionnamelen, uint16_t ordinal, int isdata, const char* functionforwardername, size_t functionforwardernamelen, void* callbackdata);
+
+/*! \brief iterate through all exported symbols without allocating memory for each string
+ * \param  pe_file               handle as returned by pefile_create()
+ * \param  callbackfn            callback function called for each exported symbol
+ * \param  callbackdata          callback data passed to \b callbackfn
+ * \return 0 on success or one of the PE_RESULT_* status result codes
+ * \sa     pefile_create()
+ * \sa     pefile_list_exports()
+ * \sa     PEfile_list_exports_v2_fn
+ */
+DLL_EXPORT_PEDEPS int pefile_list_exports_v2 (pefile_handle pe_file, PEfile_list_exports_v2_fn callbackfn, void* callbackdata);
+
+/*! \brief look up exported symbol by name
+ * \details Performs a binary search in the sorted export name table, only reading
+ *          the names needed for the comparisons. The export tables are loaded
+ *          the first time an exported symbol is looked up and are kept until the
+ *          file is closed.
+ * \param  pe_file               handle as returned by pefile_create()
+ * \param  name                  name of exported symbol to look up (case sensitive)
+ * \param  ordinal               pointer that will receive the ordinal number of the symbol (or NULL)
+ * \param  isdata                pointer that will receive 0 for function or non-zero for data variable (or NULL)
+ * \param  forwardername         pointer that will receive the name of the forwarder function (notation: module.function) or NULL if not forwarded (or NULL),
+ *                               valid until the file is closed
+ * \param  forwardernamelen      pointer that will receive the length of \b forwardername (or NULL)
+ * \return 0 if found, PE_RESULT_NOT_FOUND if not found
+ * \sa     pefile_create()
+ * \sa     pefile_find_export_by_ordinal()
+ * \sa     pefile_list_exports_v2()
+ */
+DLL_EXPORT_PEDEPS int pefile_find_export_by_name (pefile_handle pe_file, const char* name, uint16_t* ordinal, int* isdata, const char** forwardername, size_t* forwardernamelen);
+
+/*! \brief look up exported symbol by ordinal number
+ * \param  pe_file               handle as returned by pefile_create()
+ * \param  ordinal               ordinal number of exported symbol to look up
+ * \param  isdata                pointer that will receive 0 for function or non-zero for data variable (or NULL)
+ * \param  forwardername         pointer that will receive the name of the forwarder function (notation: module.function) or NULL if not forwarded (or NULL),
+ *                               valid until the file is closed
+ * \param  forwardernamelen      pointer that will receive the length of \b forwardername (or NULL)
+ * \return 0 if found, PE_RESULT_NOT_FOUND if not found
+ * \sa     pefile_create()
+ * \sa     pefile_find_export_by_name()
+ * \sa     pefile_list_exports_v2()
+ */
+DLL_EXPORT_PEDEPS int pefile_find_export_by_ordinal (pefile_handle pe_file, uint16_t ordinal, int* isdata, const char** forwardername, size_t* forwardernamelen);
+
+/*! \brief look up exported symbol by name using hint
+ * \details The hint is used as index in the export name table first, which is
+ *          what the Windows loader does, so only one name comparison is needed
+ *          if the hint is correct. Falls back to a binary search otherwise.
+ * \param  pe_file               handle as returned by pefile_create()
+ * \param  name                  name of exported symbol to look up (case sensitive)
+ * \param  hint                  index in export name table where the symbol is expected
+ * \param  ordinal               pointer that will receive the ordinal number of the symbol (or NULL)
+ * \param  isdata                pointer that will receive 0 for function or non-zero for data variable (or NULL)
+ * \param  forwardername         pointer that will receive the name of the forwarder function (notation: module.function) or NULL if not forwarded (or NULL),
+ *                               valid until the file is closed
+ * \param  forwardernamelen      pointer that will receive the length of \b forwardername (or NULL)
+ * \return 0 if found, PE_RESULT_NOT_FOUND if not found
+ * \sa     pefile_create()
+ * \sa     pefile_find_export_by_name()
+ * \sa     pefile_check_import_bindings()
+ */
+DLL_EXPORT_PEDEPS int pefile_find_export_by_hint (pefile_handle pe_file, const char* name, uint16_t hint, uint16_t* ordinal, int* isdata, const char** forwardername, size_t* forwardernamelen);
+
+/*! \brief callback function called by pefile_check_import_bindings() for each import
+ * \param  import                import record being checked
+ * \param  found                 non-zero if the symbol is exported by the module
+ * \param  ordinal               ordinal number of the exported symbol (only if found)
+ * \param  isdata                0 for function, non-zero for data variable (only if found)
+ * \param  forwardername         name of forwarder function (notation: module.function) or NULL if not forwarded
+ * \param  forwardernamelen      length of \b forwardername
+ * \param  callbackdata          callback data passed via pefile_check_import_bindings()
+ * \return 0 to continue processing, non-zero to abort
+ * \sa     pefile_check_import_bindings()
+ */
+typedef int (*PEfile_check_import_binding_fn) (const struct pefile_import_struct* import, int found, uint16_t ordinal, int isdata, const char* forwardername, size_t forwardernamelen, void* callbackdata);
+
+/*! \brief check which imports of a module are exported by that module
+ * \details Imports by name are looked up with pefile_find_export_by_hint(),
+ *          imports by ordinal with pefile_find_export_by_ordinal().
+ * \param  pe_file               handle of the imported module as returned by pefile_create()
+ * \param  imports               import table of the importing file as returned by pefile_get_imports()
+ * \param  moduleindex           index of the imported module in \b imports
+ * \param  callbackfn            callback function called for each import of the module
+ * \param  callbackdata          callback data passed to \b callbackfn
+ * \return 0 on success or one of the PE_RESULT_* status result codes
+ * \sa     pefile_get_imports()
+ * \sa     pefile_find_export_by_hint()
+ * \sa     PEfile_check_import_binding_fn
+ */
+DLL_EXPORT_PEDEPS int pefile_check_import_bindings (pefile_handle pe_file, const struct pefile_imports_struct* imports, uint32_t moduleindex, PEfile_check_import_binding_fn callbackfn, void* callbackdata);
+
 /*! \brief structure to hold resource directory group or entry information
  * \sa     pefile_list_resources()
  * \sa     PEfile_list_resourcegroups_fn()
@@ -439,6 +818,263 @@ typedef int (*PEfile_list_resources_fn) (pefile_handle pe_file, struct pefile_re
  */
 DLL_EXPORT_PEDEPS int pefile_list_resources (pefile_handle pe_file, PEfile_list_resourcegroups_fn groupcallbackfn, PEfile_list_resources_fn entrycallbackfn, void* callbackdata);
 
+/*! \brief information about a file passed to the callback function of pefile_scan_batch()
+ * \sa     pefile_scan_batch()
+ * \sa     PEfile_scan_batch_fn
+ */
+struct pefile_scan_result_struct {
+  size_t index;                         /**< index of the file in the list of paths */
+  const char* filename;                 /**< path of the file */
+  int status;                           /**< 0 on success or one of the PE_RESULT_* status result codes */
+  struct pefile_probe_info_struct info; /**< basic information from the headers (only if status is 0) */
+  pefile_handle pe_file;                /**< handle of the open file that can be used for further queries (NULL if status is not 0) */
+  const struct pefile_imports_struct* imports;  /**< all imported symbols (NULL if status is not 0) */
+  uint32_t exportcount;                 /**< number of entries in the export address table */
+  uint32_t namedexportcount;            /**< number of exported symbols with a name */
+};
+
+/*! \brief callback function called by pefile_scan_batch() for each file
+ * \details This function is called from multiple threads at the same time.
+ *          The handle and the import table are only valid during the callback.
+ * \param  result                information about the file
+ * \param  callbackdata          callback data passed via pefile_scan_batch()
+ * \return 0 to continue processing, non-zero to stop processing files
+ * \sa     pefile_scan_batch()
+ * \sa     struct pefile_scan_result_struct
+ */
+typedef int (*PEfile_scan_batch_fn) (const struct pefile_scan_result_struct* result, void* callbackdata);
+
+/*! \brief open and process multiple files in parallel
+ * \details The files are divided over a pool of worker threads, workers that
+ *          are done take over files from workers that are still busy.
+ *          Each worker uses one handle for all files it processes.
+ *          Each file is opened, its header information and import table are
+ *          obtained and its export tables are loaded, after which
+ *          \b callbackfn is called (also for files that could not be opened).
+ *          The order in which files are processed is not defined.
+ * \param  paths                 array of paths of files to process
+ * \param  count                 number of entries in \b paths
+ * \param  nthreads              number of worker threads to use (0 for one per processor)
+ * \param  callbackfn            callback function called for each file
+ * \param  callbackdata          callback data passed to \b callbackfn
+ * \return 0 on success, one of the PE_RESULT_* status result codes or the non-zero value returned by \b callbackfn
+ * \sa     PEfile_scan_batch_fn
+ * \sa     struct pefile_scan_result_struct
+ */
+DLL_EXPORT_PEDEPS int pefile_scan_batch (const char* const* paths, size_t count, unsigned int nthreads, PEfile_scan_batch_fn callbackfn, void* callbackdata);
+
+/*! \brief handle for a dependency graph
+ * \sa     pedeps_depgraph_create()
+ * \sa     pedeps_depgraph_destroy()
+ */
+typedef struct pedeps_depgraph_struct* pedeps_depgraph_handle;
+
+/*! \brief module index used to indicate no module */
+#define PEDEPS_DEPGRAPH_NONE UINT32_MAX
+
+/*! \name PEDEPS_DEPGRAPH_* flags used by pedeps_depgraph_create()
+ * \{ */
+#define PEDEPS_DEPGRAPH_CASE_INSENSITIVE        0x01    /**< match module names case insensitively (as Windows does) */
+#define PEDEPS_DEPGRAPH_SEARCH_CURRENT_FOLDER   0x02    /**< look for modules in the current folder first */
+#define PEDEPS_DEPGRAPH_SEARCH_ROOT_FOLDER      0x04    /**< look for modules in the folder of the root file through which they are imported before the search path */
+#define PEDEPS_DEPGRAPH_DIRECT_ONLY             0x08    /**< only process the imports of root files, not of their dependencies */
+/*! \} */
+
+/*! \name PEDEPS_DEPGRAPH_MODULE_* flags returned by pedeps_depgraph_get_module_flags()
+ * \{ */
+#define PEDEPS_DEPGRAPH_MODULE_ROOT             0x01    /**< module was added with pedeps_depgraph_add_root() */
+#define PEDEPS_DEPGRAPH_MODULE_NOT_FOUND        0x02    /**< module file was not found */
+#define PEDEPS_DEPGRAPH_MODULE_PARSED           0x04    /**< imports were read from the module file */
+#define PEDEPS_DEPGRAPH_MODULE_PROVIDED         0x08    /**< imports were provided by the callback function set with pedeps_depgraph_set_imports_callback() */
+#define PEDEPS_DEPGRAPH_MODULE_ERROR            0x10    /**< module file could not be opened or its imports could not be read */
+#define PEDEPS_DEPGRAPH_MODULE_IN_CYCLE         0x20    /**< module is part of a dependency cycle */
+/*! \} */
+
+/*! \brief create a dependency graph
+ * \details A dependency graph resolves all modules needed by one or more
+ *          root files. Each module file is parsed only once and each module
+ *          name is stored only once (module names with the same name return
+ *          the same pointer).
+ *          Memory is allocated using the functions set with
+ *          pedeps_set_allocator() at the time this function is called.
+ * \param  flags                 zero or more PEDEPS_DEPGRAPH_* flags
+ * \return handle for the dependency graph or NULL on error
+ * \sa     pedeps_depgraph_destroy()
+ * \sa     pedeps_depgraph_add_search_path()
+ * \sa     pedeps_depgraph_add_root()
+ * \sa     pedeps_depgraph_build()
+ */
+DLL_EXPORT_PEDEPS pedeps_depgraph_handle pedeps_depgraph_create (unsigned int flags);
+
+/*! \brief clean up dependency graph
+ * \param  graph                 dependency graph handle
+ * \sa     pedeps_depgraph_create()
+ */
+DLL_EXPORT_PEDEPS void pedeps_depgraph_destroy (pedeps_depgraph_handle graph);
+
+/*! \brief add folder to the search path
+ * \details Folders are searched in the order they were added.
+ *          The list of files in the folder is read once when it is added.
+ * \param  graph                 dependency graph handle
+ * \param  path                  path of the folder
+ * \return 0 on success or one of the PE_RESULT_* status result codes
+ * \sa     pedeps_depgraph_create()
+ */
+DLL_EXPORT_PEDEPS int pedeps_depgraph_add_search_path (pedeps_depgraph_handle graph, const char* path);
+
+/*! \brief add file for which dependencies must be resolved
+ * \param  graph                 dependency graph handle
+ * \param  path                  path of the file
+ * \return 0 on success or one of the PE_RESULT_* status result codes
+ * \sa     pedeps_depgraph_create()
+ * \sa     pedeps_depgraph_build()
+ */
+DLL_EXPORT_PEDEPS int pedeps_depgraph_add_root (pedeps_depgraph_handle graph, const char* path);
+
+/*! \brief callback function called by pedeps_depgraph_build() before parsing a module file
+ * \details This allows the application to provide the imported module names
+ *          (e.g. from a cache) by calling pedeps_depgraph_add_import().
+ *          This function is only called from the thread that called pedeps_depgraph_build().
+ * \param  graph                 dependency graph handle
+ * \param  module                index of the module
+ * \param  path                  path of the module file
+ * \param  callbackdata          callback data passed via pedeps_depgraph_set_imports_callback()
+ * \return non-zero if the imports were provided or 0 to parse the file (discarding any imports added)
+ * \sa     pedeps_depgraph_set_imports_callback()
+ * \sa     pedeps_depgraph_add_import()
+ */
+typedef int (*PEdepgraph_get_imports_fn) (pedeps_depgraph_handle graph, uint32_t module, const char* path, void* callbackdata);
+
+/*! \brief set callback function used to provide the imported module names of module files
+ * \param  graph                 dependency graph handle
+ * \param  callbackfn            callback function or NULL to always parse files
+ * \param  callbackdata          callback data passed to \b callbackfn
+ * \sa     PEdepgraph_get_imports_fn
+ */
+DLL_EXPORT_PEDEPS void pedeps_depgraph_set_imports_callback (pedeps_depgraph_handle graph, PEdepgraph_get_imports_fn callbackfn, void* callbackdata);
+
+/*! \brief add imported module name to a module
+ * \details Only to be used from a callback function of type PEdepgraph_get_imports_fn.
+ * \param  graph                 dependency graph handle
+ * \param  module                index of the module
+ * \param  modulename            name of the imported module
+ * \return 0 on success, PE_RESULT_NOT_FOUND if \b module is not valid or one of the other PE_RESULT_* status result codes
+ * \sa     PEdepgraph_get_imports_fn
+ */
+DLL_EXPORT_PEDEPS int pedeps_depgraph_add_import (pedeps_depgraph_handle graph, uint32_t module, const char* modulename);
+
+/*! \brief resolve all dependencies of the root files
+ * \details Modules are processed one level at a time, the module files of
+ *          each level are parsed in parallel using pefile_scan_batch().
+ *          Module names are resolved in a fixed order so module indexes
+ *          don't depend on the number of threads.
+ *          Modules are searched for in the current folder, the folder of
+ *          the root file and the search path (depending on the flags).
+ *          This function can be called again after adding more root files,
+ *          modules that were already processed are not parsed again.
+ * \param  graph                 dependency graph handle
+ * \param  nthreads              number of worker threads to use (0 for one per processor)
+ * \return 0 on success or one of the PE_RESULT_* status result codes
+ * \sa     pedeps_depgraph_add_root()
+ * \sa     pedeps_depgraph_get_order()
+ */
+DLL_EXPORT_PEDEPS int pedeps_depgraph_build (pedeps_depgraph_handle graph, unsigned int nthreads);
+
+/*! \brief get number of modules in the dependency graph
+ * \details Modules are numbered from 0, root files come first in the order they were added.
+ * \param  graph                 dependency graph handle
+ * \return number of modules
+ */
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_get_module_count (pedeps_depgraph_handle graph);
+
+/*! \brief get file name of module
+ * \details The same pointer is returned for all modules with the same name.
+ *          The pointer is valid until the graph is modified.
+ * \param  graph                 dependency graph handle
+ * \param  module                index of the module
+ * \return module name or NULL if \b module is not valid
+ * \sa     pedeps_depgraph_get_module_atom()
+ */
+DLL_EXPORT_PEDEPS const char* pedeps_depgraph_get_module_name (pedeps_depgraph_handle graph, uint32_t module);
+
+/*! \brief get unique number for the file name of module
+ * \details Modules with the same name (e.g. found in different folders) have the same number.
+ * \param  graph                 dependency graph handle
+ * \param  module                index of the module
+ * \return module name number or PEDEPS_DEPGRAPH_NONE if \b module is not valid
+ * \sa     pedeps_depgraph_get_module_name()
+ */
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_get_module_atom (pedeps_depgraph_handle graph, uint32_t module);
+
+/*! \brief get path of module file
+ * \details The pointer is valid until the graph is modified.
+ * \param  graph                 dependency graph handle
+ * \param  module                index of the module
+ * \return path or NULL if the module file was not found
+ */
+DLL_EXPORT_PEDEPS const char* pedeps_depgraph_get_module_path (pedeps_depgraph_handle graph, uint32_t module);
+
+/*! \brief get flags of module
+ * \param  graph                 dependency graph handle
+ * \param  module                index of the module
+ * \return zero or more PEDEPS_DEPGRAPH_MODULE_* flags
+ */
+DLL_EXPORT_PEDEPS unsigned int pedeps_depgraph_get_module_flags (pedeps_depgraph_handle graph, uint32_t module);
+
+/*! \brief get modules imported by module
+ * \details Only valid after pedeps_depgraph_build(), each module is listed only once.
+ * \param  graph                 dependency graph handle
+ * \param  module                index of the module
+ * \param  dependencies          pointer that will receive the array of module indexes
+ * \return number of entries in \b dependencies
+ * \sa     pedeps_depgraph_get_dependents()
+ */
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_get_dependencies (pedeps_depgraph_handle graph, uint32_t module, const uint32_t** dependencies);
+
+/*! \brief get modules that import module
+ * \details Only valid after pedeps_depgraph_build().
+ * \param  graph                 dependency graph handle
+ * \param  module                index of the module
+ * \param  dependents            pointer that will receive the array of module indexes
+ * \return number of entries in \b dependents
+ * \sa     pedeps_depgraph_get_dependencies()
+ */
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_get_dependents (pedeps_depgraph_handle graph, uint32_t module, const uint32_t** dependents);
+
+/*! \brief get all modules in order of dependency
+ * \details Only valid after pedeps_depgraph_build().
+ *          Modules are listed after the modules they depend on, except for
+ *          modules in the same cycle which are listed next to each other.
+ * \param  graph                 dependency graph handle
+ * \param  order                 pointer that will receive the array of module indexes
+ * \return number of entries in \b order
+ * \sa     pedeps_depgraph_get_cycle()
+ */
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_get_order (pedeps_depgraph_handle graph, const uint32_t** order);
+
+/*! \brief get dependency cycle a module is part of
+ * \details Only valid after pedeps_depgraph_build().
+ * \param  graph                 dependency graph handle
+ * \param  module                index of the module
+ * \return cycle number (starting at 1) or 0 if the module is not part of a cycle
+ * \sa     pedeps_depgraph_get_cycle_count()
+ */
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_get_cycle (pedeps_depgraph_handle graph, uint32_t module);
+
+/*! \brief get number of dependency cycles
+ * \param  graph                 dependency graph handle
+ * \return number of cycles
+ * \sa     pedeps_depgraph_get_cycle()
+ */
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_get_cycle_count (pedeps_depgraph_handle graph);
+
+/*! \brief find module by file name
+ * \param  graph                 dependency graph handle
+ * \param  modulename            file name of the module
+ * \return index of the first module with this name or PEDEPS_DEPGRAPH_NONE if not found
+ */
+DLL_EXPORT_PEDEPS uint32_t pedeps_depgraph_find_module (pedeps_depgraph_handle graph, const char* modulename);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,85 @@
+/*****************************************************************************
+Copyright (C)  2019  Brecht Sanders  All Rights Reserved
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*****************************************************************************/
+
+/**
+ * @file pethread.h
+ * @brief pedeps internal header file with portable thread functions
+ * @author Brecht Sanders
+ *
+ * This header file defines the mutex and thread functions used internally
+ * by the pedeps library and the utilities, it is not part of the API
+ */
+
+#ifndef INCLUDED_PE_THREAD_H
+#define INCLUDED_PE_THREAD_H
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION pe_mutex;
+#define pe_mutex_init(m) InitializeCriticalSection(m)
+#define pe_mutex_init_recursive(m) InitializeCriticalSection(m)
+#define pe_mutex_destroy(m) DeleteCriticalSection(m)
+#define pe_mutex_lock(m) EnterCriticalSection(m)
+#define pe_mutex_unlock(m) LeaveCriticalSection(m)
+typedef HANDLE pe_thread;
+#define PE_THREAD_FN(name, arg) DWORD WINAPI name (LPVOID arg)
+#define PE_THREAD_RETURN 0
+#define pe_thread_create(t, fn, arg) ((*(t) = CreateThread(NULL, 0, fn, arg, 0, NULL)) != NULL ? 0 : 1)
+#define pe_thread_join(t) (WaitForSingleObject(t, INFINITE), CloseHandle(t))
+#else
+typedef pthread_mutex_t pe_mutex;
+#define pe_mutex_init(m) pthread_mutex_init(m, NULL)
+static inline void pe_mutex_init_recursive (pe_mutex* m)
+{
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(m, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+#define pe_mutex_destroy(m) pthread_mutex_destroy(m)
+#define pe_mutex_lock(m) pthread_mutex_lock(m)
+#define pe_mutex_unlock(m) pthread_mutex_unlock(m)
+typedef pthread_t pe_thread;
+#define PE_THREAD_FN(name, arg) void* name (void* arg)
+#define PE_THREAD_RETURN NULL
+#define pe_thread_create(t, fn, arg) pthread_create(t, NULL, fn, arg)
+#define pe_thread_join(t) pthread_join(t, NULL)
+#endif
+
+//get number of processors available
+static inline unsigned int get_processor_count ()
+{
+#ifdef _WIN32
+  SYSTEM_INFO sysinfo;
+  GetSystemInfo(&sysinfo);
+  return (sysinfo.dwNumberOfProcessors > 0 ? (unsigned int)sysinfo.dwNumberOfProcessors : 1);
+#else
+  long n;
+  return ((n = sysconf(_SC_NPROCESSORS_ONLN)) > 0 ? (unsigned int)n : 1);
+#endif
+}
+
+#endif
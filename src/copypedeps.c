@@ -17,10 +17,15 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 *****************************************************************************/
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
 #include "pestructs.h"
 #include "pedeps.h"
 #include "pedeps_version.h"
+#include "pethread.h"
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -34,6 +39,13 @@ THE SOFTWARE.
 #include <shlwapi.h>
 #else
 #include <utime.h>
+#include <sys/mman.h>
+#endif
+#ifdef __linux__
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
 #endif
 #include <avl.h>
 
@@ -48,6 +60,10 @@ THE SOFTWARE.
 #define PATHSEPARATOR '\\'
 #define ISPATHSEPARATOR(c) ((c) == '\\' || (c) == '/')
 #define PATHLISTSEPARATOR ';'
+#define lstat stat
+#ifndef S_ISLNK
+#define S_ISLNK(m) 0
+#endif
 #else
 #ifndef PATH_MAX
 #include <limits.h>
@@ -119,148 +135,676 @@ uint64_t get_block_size (const char* path)
 #endif
 }
 
-int copy_file (const char* srcfile, const char* dstfile, int overwrite)
+//copy create/access/write timestamps
+void copy_file_times (const char* srcfile, const char* dstfile)
+{
+#if _WIN32
+  HANDLE handle;
+  FILETIME creationtime;
+  FILETIME accesstime;
+  FILETIME writetime;
+  if ((handle = CreateFileA(srcfile, GENERIC_READ | FILE_READ_ATTRIBUTES, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL)) != INVALID_HANDLE_VALUE) {
+    if (GetFileTime(handle, &creationtime, &accesstime, &writetime)) {
+      CloseHandle(handle);
+      if ((handle = CreateFileA(dstfile, GENERIC_READ | FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL)) != INVALID_HANDLE_VALUE) {
+        //SYSTEMTIME st;
+        //GetSystemTime(&st);
+        //SystemTimeToFileTime(&st, &writetime);
+        SetFileTime(handle, &creationtime, &accesstime, &writetime);
+        CloseHandle(handle);
+      }
+    }
+  }
+#else
+  struct stat srctimes;
+  struct utimbuf dsttimes;
+  //get source file date and time values
+  if (stat(srcfile, &srctimes) == 0) {
+    //set destination file date and time values
+    dsttimes.actime = srctimes.st_atime;
+    dsttimes.modtime = srctimes.st_mtime;//or use time(NULL)
+    utime(dstfile, &dsttimes);
+  }
+#endif
+}
+
+#ifdef __linux__
+#define COPY_FILE_KERNEL_CHUNK_SIZE 0x40000000
+#endif
+
+//copy file data without passing it through user space (reflink or in-kernel copy)
+//returns 0 on success, -1 if not supported (nothing was written) or a positive value on error
+int copy_file_data_kernel (int srchandle, int dsthandle)
 {
-  void* buf;
+#ifdef __linux__
+  ssize_t n;
+  uint64_t copied = 0;
+  int usesendfile = 0;
+#ifdef FICLONE
+  //share data blocks if supported by the file system (btrfs, XFS)
+  if (ioctl(dsthandle, FICLONE, srchandle) == 0)
+    return 0;
+#endif
+  while (1) {
+    if (!usesendfile) {
+      //copy within the kernel (also allows server side copy on network file systems)
+      if ((n = copy_file_range(srchandle, NULL, dsthandle, NULL, COPY_FILE_KERNEL_CHUNK_SIZE, 0)) < 0 && copied == 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP || errno == EPERM)) {
+        usesendfile = 1;
+        continue;
+      }
+    } else {
+      if ((n = sendfile(dsthandle, srchandle, NULL, COPY_FILE_KERNEL_CHUNK_SIZE)) < 0 && copied == 0 && (errno == ENOSYS || errno == EINVAL))
+        return -1;
+    }
+    if (n < 0)
+      return 3;
+    if (n == 0)
+      break;
+    copied += n;
+  }
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+//copy modes for each destination of copy_file_multiple()
+#define COPY_TARGET_CREATE 0
+#define COPY_TARGET_OVERWRITE 1
+#define COPY_TARGET_SYNC 2
+
+//destination file of copy_file_multiple()
+struct copy_target_struct {
+  const char* path;
+  int mode;             //COPY_TARGET_CREATE, COPY_TARGET_OVERWRITE or COPY_TARGET_SYNC (only write the part that differs)
+  int result;           //set to 0 if copied, -1 if unchanged (COPY_TARGET_SYNC only) or a positive value on error
+  int handle;
+  int compare;
+  int written;
+  uint64_t pos;
+};
+
+//close destination file of copy_file_multiple() and set the result
+void copy_target_done (struct copy_target_struct* target, int result)
+{
+  close(target->handle);
+  target->handle = -1;
+  target->result = result;
+}
+
+//copy source file to one or more destination files, reading the source file only once
+//returns 0 if all destinations were copied or unchanged (or would be copied if dryrun is set), otherwise non-zero
+int copy_file_multiple (const char* srcfile, struct copy_target_struct* targets, size_t count, int dryrun)
+{
+  void* buf = NULL;
+  void* dstbuf = NULL;
   uint64_t buflen;
   uint64_t blocksize;
   int srchandle;
-  int dsthandle;
-  ssize_t n;
+  struct stat srcstat;
+  struct stat dststat;
+  ssize_t n = 0;
+  ssize_t m;
+  ssize_t l;
+  size_t active = 0;
+  size_t i;
   int result = 0;
   //open source file
-  if ((srchandle = open(srcfile, O_RDONLY | O_BINARY)) == -1) {
+  if ((srchandle = open(srcfile, O_RDONLY | O_BINARY)) == -1 || fstat(srchandle, &srcstat) != 0) {
+    if (srchandle != -1)
+      close(srchandle);
+    for (i = 0; i < count; i++)
+      targets[i].result = 1;
     return 1;
   }
-  //open destination file
-  if ((dsthandle = open(dstfile, O_WRONLY | O_BINARY | O_CREAT | (overwrite ? O_TRUNC : O_EXCL), S_IWUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH)) == -1) {
-    close(srchandle);
-    return 2;
-  }
   //determine buffer size based on largest block size
   buflen = 4096;
   if ((blocksize = get_block_size(srcfile)) > buflen)
     buflen = blocksize;
-  if ((blocksize = get_block_size(dstfile)) > buflen)
-    buflen = blocksize;
-  //allocate buffer
-  if ((buf = malloc(buflen)) == NULL) {
-    result = -1;
-  } else {
-    //copy data
-    while ((n = read(srchandle, buf, buflen)) > 0) {
-      if (write(dsthandle, buf, n) < n) {
-        result = 3;
-        break;
+  //open destination files
+  for (i = 0; i < count; i++) {
+    targets[i].result = 0;
+    targets[i].handle = -1;
+    targets[i].compare = 0;
+    targets[i].written = 0;
+    targets[i].pos = 0;
+    if (targets[i].mode == COPY_TARGET_SYNC && stat(targets[i].path, &dststat) == 0 && dststat.st_size == srcstat.st_size) {
+      //compare contents if size is the same
+      targets[i].compare = 1;
+      targets[i].handle = open(targets[i].path, (dryrun ? O_RDONLY : O_RDWR) | O_BINARY);
+    } else if (!dryrun) {
+      targets[i].handle = open(targets[i].path, O_WRONLY | O_BINARY | O_CREAT | (targets[i].mode == COPY_TARGET_CREATE ? O_EXCL : O_TRUNC), S_IWUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+    } else {
+      continue;
+    }
+    if (targets[i].handle == -1) {
+      targets[i].result = 2;
+      continue;
+    }
+    //copy data using kernel features if possible
+    if (!targets[i].compare) {
+      targets[i].written = 1;
+      if (lseek(srchandle, 0, SEEK_SET) != 0) {
+        copy_target_done(&targets[i], 3);
+        continue;
+      }
+      if ((result = copy_file_data_kernel(srchandle, targets[i].handle)) >= 0) {
+        copy_target_done(&targets[i], result);
+        continue;
       }
     }
+    if ((blocksize = get_block_size(targets[i].path)) > buflen)
+      buflen = blocksize;
+    active++;
   }
-  //close files
-  close(srchandle);
-  close(dsthandle);
-  //delete destination file on error
-  if (result != 0)
-    unlink(dstfile);
-  //deallocate buffer
-  free(buf);
-  //copy create/access/write timestamps
-  if (result == 0) {
-#if _WIN32
-    HANDLE handle;
-    FILETIME creationtime;
-    FILETIME accesstime;
-    FILETIME writetime;
-    if ((handle = CreateFileA(srcfile, GENERIC_READ | FILE_READ_ATTRIBUTES, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL)) != INVALID_HANDLE_VALUE) {
-      if (GetFileTime(handle, &creationtime, &accesstime, &writetime)) {
-        CloseHandle(handle);
-        if ((handle = CreateFileA(dstfile, GENERIC_READ | FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL)) != INVALID_HANDLE_VALUE) {
-          //SYSTEMTIME st;
-          //GetSystemTime(&st);
-          //SystemTimeToFileTime(&st, &writetime);
-          SetFileTime(handle, &creationtime, &accesstime, &writetime);
-          CloseHandle(handle);
+  //copy the remaining destinations via a buffer
+  if (active > 0) {
+    if (lseek(srchandle, 0, SEEK_SET) != 0 || (buf = malloc(buflen)) == NULL || (dstbuf = malloc(buflen)) == NULL) {
+      for (i = 0; i < count; i++) {
+        if (targets[i].handle != -1)
+          copy_target_done(&targets[i], 4);
+      }
+      active = 0;
+    }
+    while (active > 0 && (n = read(srchandle, buf, buflen)) > 0) {
+      for (i = 0; i < count; i++) {
+        if (targets[i].handle == -1)
+          continue;
+        if (targets[i].compare) {
+          m = 0;
+          while (m < n && (l = read(targets[i].handle, (uint8_t*)dstbuf + m, n - m)) > 0)
+            m += l;
+          if (m == n && memcmp(buf, dstbuf, n) == 0) {
+            targets[i].pos += n;
+            continue;
+          }
+          //contents differ
+          if (dryrun) {
+            copy_target_done(&targets[i], 0);
+            active--;
+            continue;
+          }
+          //write the remaining data starting from the block that differs
+          targets[i].compare = 0;
+          targets[i].written = 1;
+          if (lseek(targets[i].handle, targets[i].pos, SEEK_SET) == (off_t)-1) {
+            copy_target_done(&targets[i], 3);
+            active--;
+            continue;
+          }
+        }
+        if (write(targets[i].handle, buf, n) < n) {
+          copy_target_done(&targets[i], 3);
+          active--;
+          continue;
         }
+        targets[i].pos += n;
       }
     }
-#else
-    struct stat srctimes;
-    struct utimbuf dsttimes;
-    //get source file date and time values
-    if (stat(srcfile, &srctimes) == 0) {
-      //set destination file date and time values
-      dsttimes.actime = srctimes.st_atime;
-      dsttimes.modtime = srctimes.st_mtime;//or use time(NULL)
-      utime(dstfile, &dsttimes);
+    //finish the remaining destinations
+    for (i = 0; i < count; i++) {
+      if (targets[i].handle == -1)
+        continue;
+      if (active > 0 && n < 0) {
+        copy_target_done(&targets[i], 1);
+      } else if (targets[i].compare) {
+        //the source file may have been truncated since it was checked
+        if (read(targets[i].handle, dstbuf, 1) == 0) {
+          copy_target_done(&targets[i], -1);
+        } else if (dryrun) {
+          copy_target_done(&targets[i], 0);
+        } else {
+          targets[i].written = 1;
+          copy_target_done(&targets[i], (ftruncate(targets[i].handle, targets[i].pos) == 0 ? 0 : 3));
+        }
+      } else {
+        copy_target_done(&targets[i], (ftruncate(targets[i].handle, targets[i].pos) == 0 ? 0 : 3));
+      }
+    }
+  }
+  //close source file
+  close(srchandle);
+  //deallocate buffers
+  free(buf);
+  free(dstbuf);
+  result = 0;
+  for (i = 0; i < count; i++) {
+    if (targets[i].result > 0) {
+      //delete destination file on error
+      if (targets[i].written)
+        unlink(targets[i].path);
+      result = 1;
+    } else if (!dryrun) {
+      //copy timestamps (also for unchanged files so they are recognized as unchanged by size and time next time)
+      copy_file_times(srcfile, targets[i].path);
     }
-#endif
   }
   return result;
 }
 
-struct string_list_struct {
-  char* data;
-  struct string_list_struct* next;
+//cache file with the imported module names of previously processed files, layout:
+//header, entries (sorted by path), module name offsets, string data
+#define DEPENDANCY_CACHE_MAGIC "CPDCACHE"
+#define DEPENDANCY_CACHE_VERSION 2
+#define DEPENDANCY_CACHE_ENV "COPYPEDEPS_CACHE"
+
+struct dependancy_cache_header_struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t entrycount;
+  uint32_t modulecount;
+  uint32_t stringsize;
 };
 
-void string_list_free (struct string_list_struct** list)
+struct dependancy_cache_entry_struct {
+  uint64_t size;
+  int64_t mtime;
+  uint64_t inode;
+  uint32_t path;          //offset of absolute path in string data
+  uint32_t firstmodule;   //index of first module name offset
+  uint32_t modulecount;
+  uint32_t mtimensec;     //nanoseconds part of mtime (0 if not available)
+};
+
+//cache entry added during this run
+struct dependancy_cache_new_struct {
+  char* path;
+  uint64_t size;
+  int64_t mtime;
+  uint32_t mtimensec;
+  uint64_t inode;
+  char* modules;          //module names, each followed by a null character
+  size_t moduleslen;
+  uint32_t modulecount;
+  struct dependancy_cache_new_struct* next;
+};
+
+struct dependancy_cache_struct {
+  char* filename;
+  void* data;
+  size_t datalen;
+#ifdef _WIN32
+  HANDLE filehandle;
+  HANDLE mappinghandle;
+#endif
+  uint32_t entrycount;
+  const struct dependancy_cache_entry_struct* entries;
+  const uint32_t* modules;
+  const char* strings;
+  struct dependancy_cache_new_struct* newentries;
+  size_t newcount;
+  pe_mutex lock;
+};
+
+//check if the mapped cache file is valid
+int dependancy_cache_validate (struct dependancy_cache_struct* cache)
 {
-  struct string_list_struct* next;
-  struct string_list_struct* p = *list;
-  while (p) {
-    next = p->next;
-    free(p->data);
-    free(p);
-    p = next;
+  const struct dependancy_cache_header_struct* header = (const struct dependancy_cache_header_struct*)cache->data;
+  uint64_t len;
+  uint32_t i;
+  uint32_t j;
+  if (cache->datalen < sizeof(struct dependancy_cache_header_struct) || memcmp(header->magic, DEPENDANCY_CACHE_MAGIC, 8) != 0 || header->version != DEPENDANCY_CACHE_VERSION)
+    return 0;
+  len = sizeof(struct dependancy_cache_header_struct) + (uint64_t)header->entrycount * sizeof(struct dependancy_cache_entry_struct) + (uint64_t)header->modulecount * sizeof(uint32_t);
+  if (len + header->stringsize != cache->datalen || (header->stringsize > 0 && ((const char*)cache->data)[cache->datalen - 1] != 0))
+    return 0;
+  cache->entries = (const struct dependancy_cache_entry_struct*)((const uint8_t*)cache->data + sizeof(struct dependancy_cache_header_struct));
+  cache->modules = (const uint32_t*)(cache->entries + header->entrycount);
+  cache->strings = (const char*)cache->data + len;
+  for (i = 0; i < header->entrycount; i++) {
+    if (cache->entries[i].path >= header->stringsize || cache->entries[i].firstmodule > header->modulecount || cache->entries[i].modulecount > header->modulecount - cache->entries[i].firstmodule)
+      return 0;
   }
-  *list = NULL;
+  for (j = 0; j < header->modulecount; j++) {
+    if (cache->modules[j] >= header->stringsize)
+      return 0;
+  }
+  cache->entrycount = header->entrycount;
+  return 1;
 }
 
-struct string_list_struct* string_list_append_allocated (struct string_list_struct** list, char* data)
+void dependancy_cache_unmap (struct dependancy_cache_struct* cache)
 {
-  struct string_list_struct** p = list;
-  while (*p) {
-    p = &((*p)->next);
+  if (cache->data) {
+#ifdef _WIN32
+    UnmapViewOfFile(cache->data);
+    CloseHandle(cache->mappinghandle);
+    CloseHandle(cache->filehandle);
+#else
+    munmap(cache->data, cache->datalen);
+#endif
   }
-  if ((*p = (struct string_list_struct*)malloc(sizeof(struct string_list_struct))) != NULL) {
-    (*p)->data = data;
-    (*p)->next = NULL;
+  cache->data = NULL;
+  cache->datalen = 0;
+  cache->entrycount = 0;
+}
+
+//open cache file (a missing or invalid cache file results in an empty cache)
+struct dependancy_cache_struct* dependancy_cache_open (const char* filename)
+{
+  struct dependancy_cache_struct* cache;
+#ifdef _WIN32
+  LARGE_INTEGER filesize;
+#else
+  int handle;
+  struct stat statbuf;
+#endif
+  if ((cache = (struct dependancy_cache_struct*)malloc(sizeof(struct dependancy_cache_struct))) == NULL)
+    return NULL;
+  if ((cache->filename = strdup(filename)) == NULL) {
+    free(cache);
+    return NULL;
   }
-  return *p;
+  cache->data = NULL;
+  cache->datalen = 0;
+  cache->entrycount = 0;
+  cache->newentries = NULL;
+  cache->newcount = 0;
+  pe_mutex_init(&cache->lock);
+  //map cache file in memory
+#ifdef _WIN32
+  if ((cache->filehandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL)) != INVALID_HANDLE_VALUE) {
+    if (GetFileSizeEx(cache->filehandle, &filesize) && filesize.QuadPart > 0 && (uint64_t)filesize.QuadPart <= SIZE_MAX && (cache->mappinghandle = CreateFileMappingA(cache->filehandle, NULL, PAGE_READONLY, 0, 0, NULL)) != NULL) {
+      if ((cache->data = MapViewOfFile(cache->mappinghandle, FILE_MAP_READ, 0, 0, 0)) != NULL)
+        cache->datalen = (size_t)filesize.QuadPart;
+      else
+        CloseHandle(cache->mappinghandle);
+    }
+    if (!cache->data)
+      CloseHandle(cache->filehandle);
+  }
+#else
+  if ((handle = open(filename, O_RDONLY | O_BINARY)) != -1) {
+    if (fstat(handle, &statbuf) == 0 && statbuf.st_size > 0 && (uint64_t)statbuf.st_size <= SIZE_MAX) {
+      if ((cache->data = mmap(NULL, (size_t)statbuf.st_size, PROT_READ, MAP_PRIVATE, handle, 0)) != MAP_FAILED)
+        cache->datalen = (size_t)statbuf.st_size;
+      else
+        cache->data = NULL;
+    }
+    close(handle);
+  }
+#endif
+  if (cache->data && !dependancy_cache_validate(cache))
+    dependancy_cache_unmap(cache);
+  return cache;
 }
 
-struct string_list_struct* string_list_append (struct string_list_struct** list, const char* data)
+//get nanoseconds part of modification time, so changes within the same second are detected
+uint32_t get_mtime_nsec (const struct stat* statbuf)
 {
-  return string_list_append_allocated(list, (data ? strdup(data) : NULL));
+#if defined(__APPLE__)
+  return (uint32_t)statbuf->st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+  return 0;
+#else
+  return (uint32_t)statbuf->st_mtim.tv_nsec;
+#endif
 }
 
-struct dependancy_info_struct {
-  int recursive;
-  int overwrite;
-  int dryrun;
-  int verbose;
-  avl_tree_t* filelist;
-  char* preferredpath;
-  struct string_list_struct* pathlist;
+//look up unchanged file in cache, returns NULL if not found
+const struct dependancy_cache_entry_struct* dependancy_cache_find (struct dependancy_cache_struct* cache, const char* path, const struct stat* statbuf)
+{
+  const struct dependancy_cache_entry_struct* entry;
+  uint32_t first = 0;
+  uint32_t last = cache->entrycount;
+  uint32_t i;
+  int cmp;
+  while (first < last) {
+    i = first + (last - first) / 2;
+    entry = &cache->entries[i];
+    if ((cmp = strcmp(path, cache->strings + entry->path)) == 0) {
+      if (entry->size == (uint64_t)statbuf->st_size && entry->mtime == (int64_t)statbuf->st_mtime && entry->mtimensec == get_mtime_nsec(statbuf) && entry->inode == (uint64_t)statbuf->st_ino)
+        return entry;
+      return NULL;
+    }
+    if (cmp < 0)
+      last = i;
+    else
+      first = i + 1;
+  }
+  return NULL;
+}
+
+//remember imported modules of file for the next run
+void dependancy_cache_add (struct dependancy_cache_struct* cache, const char* path, const struct stat* statbuf, pedeps_depgraph_handle graph, const uint32_t* dependencies, uint32_t dependencycount)
+{
+  struct dependancy_cache_new_struct* entry;
+  size_t len;
+  uint32_t i;
+  if ((entry = (struct dependancy_cache_new_struct*)malloc(sizeof(struct dependancy_cache_new_struct))) == NULL)
+    return;
+  entry->moduleslen = 0;
+  for (i = 0; i < dependencycount; i++)
+    entry->moduleslen += strlen(pedeps_depgraph_get_module_name(graph, dependencies[i])) + 1;
+  if ((entry->path = strdup(path)) == NULL || (entry->modules = (char*)malloc(entry->moduleslen + 1)) == NULL) {
+    free(entry->path);
+    free(entry);
+    return;
+  }
+  entry->moduleslen = 0;
+  for (i = 0; i < dependencycount; i++) {
+    len = strlen(pedeps_depgraph_get_module_name(graph, dependencies[i])) + 1;
+    memcpy(entry->modules + entry->moduleslen, pedeps_depgraph_get_module_name(graph, dependencies[i]), len);
+    entry->moduleslen += len;
+  }
+  entry->modulecount = dependencycount;
+  entry->size = (uint64_t)statbuf->st_size;
+  entry->mtime = (int64_t)statbuf->st_mtime;
+  entry->mtimensec = get_mtime_nsec(statbuf);
+  entry->inode = (uint64_t)statbuf->st_ino;
+  pe_mutex_lock(&cache->lock);
+  entry->next = cache->newentries;
+  cache->newentries = entry;
+  cache->newcount++;
+  pe_mutex_unlock(&cache->lock);
+}
+
+//entry to be written to the cache file, either from the existing cache or added during this run
+struct dependancy_cache_save_struct {
+  const char* path;
+  const struct dependancy_cache_entry_struct* oldentry;
+  const struct dependancy_cache_new_struct* newentry;
 };
 
-char* get_base_path (const char* path)
+int dependancy_cache_save_compare (const void* a, const void* b)
 {
-  char* result = NULL;
-  if (path) {
-    size_t pos = strlen(path);
-    while (pos > 0) {
-      pos--;
-      if (ISPATHSEPARATOR(path[pos]))
-        break;
+  const struct dependancy_cache_save_struct* entry1 = (const struct dependancy_cache_save_struct*)a;
+  const struct dependancy_cache_save_struct* entry2 = (const struct dependancy_cache_save_struct*)b;
+  int cmp;
+  if ((cmp = strcmp(entry1->path, entry2->path)) != 0)
+    return cmp;
+  //new entries first so they replace existing ones
+  return (entry1->newentry ? 0 : 1) - (entry2->newentry ? 0 : 1);
+}
+
+//write cache file (only if new entries were added), returns non-zero on error
+int dependancy_cache_save (struct dependancy_cache_struct* cache)
+{
+  struct dependancy_cache_save_struct* list;
+  struct dependancy_cache_new_struct* newentry;
+  struct dependancy_cache_header_struct* header;
+  struct dependancy_cache_entry_struct* entries;
+  uint32_t* modules;
+  char* strings;
+  uint8_t* buf;
+  size_t buflen;
+  size_t count = 0;
+  size_t entrycount = 0;
+  size_t modulecount = 0;
+  size_t stringsize = 0;
+  size_t len;
+  size_t i;
+  uint32_t j;
+  char* tmpfilename;
+  FILE* dst;
+  int result = 0;
+  if (cache->newcount == 0)
+    return 0;
+  //list all entries sorted by path, skipping replaced entries
+  if ((list = (struct dependancy_cache_save_struct*)malloc((cache->entrycount + cache->newcount) * sizeof(struct dependancy_cache_save_struct))) == NULL)
+    return -1;
+  for (newentry = cache->newentries; newentry; newentry = newentry->next) {
+    list[count].path = newentry->path;
+    list[count].oldentry = NULL;
+    list[count++].newentry = newentry;
+  }
+  for (j = 0; j < cache->entrycount; j++) {
+    list[count].path = cache->strings + cache->entries[j].path;
+    list[count].oldentry = &cache->entries[j];
+    list[count++].newentry = NULL;
+  }
+  qsort(list, count, sizeof(struct dependancy_cache_save_struct), dependancy_cache_save_compare);
+  for (i = 0; i < count; i++) {
+    if (entrycount > 0 && strcmp(list[entrycount - 1].path, list[i].path) == 0)
+      continue;
+    list[entrycount] = list[i];
+    stringsize += strlen(list[i].path) + 1;
+    if (list[i].newentry) {
+      modulecount += list[i].newentry->modulecount;
+      stringsize += list[i].newentry->moduleslen;
+    } else {
+      modulecount += list[i].oldentry->modulecount;
+      for (j = 0; j < list[i].oldentry->modulecount; j++)
+        stringsize += strlen(cache->strings + cache->modules[list[i].oldentry->firstmodule + j]) + 1;
     }
-    if ((result = (char*)malloc(pos + 1)) != NULL) {
-      memcpy(result, path, pos);
-      result[pos] = 0;
+    entrycount++;
+  }
+  if (entrycount > UINT32_MAX || modulecount > UINT32_MAX || stringsize > UINT32_MAX) {
+    free(list);
+    return -1;
+  }
+  //build cache file contents
+  buflen = sizeof(struct dependancy_cache_header_struct) + entrycount * sizeof(struct dependancy_cache_entry_struct) + modulecount * sizeof(uint32_t) + stringsize;
+  if ((buf = (uint8_t*)malloc(buflen)) == NULL) {
+    free(list);
+    return -1;
+  }
+  header = (struct dependancy_cache_header_struct*)buf;
+  entries = (struct dependancy_cache_entry_struct*)(buf + sizeof(struct dependancy_cache_header_struct));
+  modules = (uint32_t*)(entries + entrycount);
+  strings = (char*)(modules + modulecount);
+  memcpy(header->magic, DEPENDANCY_CACHE_MAGIC, 8);
+  header->version = DEPENDANCY_CACHE_VERSION;
+  header->entrycount = (uint32_t)entrycount;
+  header->modulecount = (uint32_t)modulecount;
+  header->stringsize = (uint32_t)stringsize;
+  modulecount = 0;
+  stringsize = 0;
+  for (i = 0; i < entrycount; i++) {
+    len = strlen(list[i].path) + 1;
+    memcpy(strings + stringsize, list[i].path, len);
+    entries[i].path = (uint32_t)stringsize;
+    entries[i].firstmodule = (uint32_t)modulecount;
+    stringsize += len;
+    if (list[i].newentry) {
+      const char* p = list[i].newentry->modules;
+      entries[i].size = list[i].newentry->size;
+      entries[i].mtime = list[i].newentry->mtime;
+      entries[i].mtimensec = list[i].newentry->mtimensec;
+      entries[i].inode = list[i].newentry->inode;
+      entries[i].modulecount = list[i].newentry->modulecount;
+      for (j = 0; j < list[i].newentry->modulecount; j++) {
+        len = strlen(p) + 1;
+        memcpy(strings + stringsize, p, len);
+        modules[modulecount++] = (uint32_t)stringsize;
+        stringsize += len;
+        p += len;
+      }
+    } else {
+      entries[i].size = list[i].oldentry->size;
+      entries[i].mtime = list[i].oldentry->mtime;
+      entries[i].mtimensec = list[i].oldentry->mtimensec;
+      entries[i].inode = list[i].oldentry->inode;
+      entries[i].modulecount = list[i].oldentry->modulecount;
+      for (j = 0; j < list[i].oldentry->modulecount; j++) {
+        const char* p = cache->strings + cache->modules[list[i].oldentry->firstmodule + j];
+        len = strlen(p) + 1;
+        memcpy(strings + stringsize, p, len);
+        modules[modulecount++] = (uint32_t)stringsize;
+        stringsize += len;
+      }
     }
   }
+  free(list);
+  //close existing cache file before replacing it
+  dependancy_cache_unmap(cache);
+  //write to temporary file and replace cache file with it
+  //room for ".", up to 20 digits of a 64-bit process ID, ".tmp" and the terminating null character
+  len = strlen(cache->filename) + 26;
+  if ((tmpfilename = (char*)malloc(len)) == NULL) {
+    free(buf);
+    return -1;
+  }
+  snprintf(tmpfilename, len, "%s.%lu.tmp", cache->filename, (unsigned long)getpid());
+  if ((dst = fopen(tmpfilename, "wb")) == NULL) {
+    result = 1;
+  } else {
+    if (fwrite(buf, 1, buflen, dst) != buflen)
+      result = 2;
+    if (fclose(dst) != 0)
+      result = 2;
+#ifdef _WIN32
+    if (result == 0 && !MoveFileExA(tmpfilename, cache->filename, MOVEFILE_REPLACE_EXISTING))
+#else
+    if (result == 0 && rename(tmpfilename, cache->filename) != 0)
+#endif
+      result = 3;
+    if (result != 0)
+      unlink(tmpfilename);
+  }
+  free(tmpfilename);
+  free(buf);
   return result;
 }
 
+void dependancy_cache_close (struct dependancy_cache_struct* cache)
+{
+  struct dependancy_cache_new_struct* next;
+  struct dependancy_cache_new_struct* p = cache->newentries;
+  while (p) {
+    next = p->next;
+    free(p->path);
+    free(p->modules);
+    free(p);
+    p = next;
+  }
+  dependancy_cache_unmap(cache);
+  pe_mutex_destroy(&cache->lock);
+  free(cache->filename);
+  free(cache);
+}
+
+//sync modes
+#define SYNC_NONE 0
+#define SYNC_TIME 1
+#define SYNC_CONTENTS 2
+
+//destination folder
+struct destination_struct {
+  char* path;             //folder path including trailing path separator
+  size_t pathlen;
+  const char* folder;     //folder as specified on the command line
+  unsigned long copiedcount;
+  unsigned long skippedcount;
+  struct destination_struct* next;
+};
+
+struct dependancy_info_struct {
+  int recursive;
+  int overwrite;
+  int dryrun;
+  int verbose;
+  int casefold;
+  int syncmode;
+  int linkmode;
+  struct destination_struct* destinations;
+  size_t destinationcount;
+  avl_tree_t* filelist;
+  pedeps_depgraph_handle graph;
+  struct dependancy_cache_struct* cache;
+  pe_mutex lock;
+};
+
 typedef int (*iterate_path_list_callback_fn)(const char* path, void* callbackdata);
 
 size_t iterate_path_list (const char* pathlist, char pathseparator, iterate_path_list_callback_fn callbackfunction, void* callbackdata)
@@ -312,121 +856,480 @@ int is_in_path (const char* path1, const char* path2)
 
 int iterate_path_add (const char* path, void* callbackdata)
 {
+  struct dependancy_info_struct* depinfo = (struct dependancy_info_struct*)callbackdata;
   if (!is_in_path(path, getenv("windir")))
-    string_list_append((struct string_list_struct**)callbackdata, path);
+    pedeps_depgraph_add_search_path(depinfo->graph, path);
   return 0;
 }
 
-char* search_path (const char* preferredpath, struct string_list_struct* pathlist, const char* filename)
+//provide imported modules of unchanged files from the cache instead of parsing them
+int get_cached_imports (pedeps_depgraph_handle graph, uint32_t module, const char* path, void* callbackdata)
+{
+  struct dependancy_cache_struct* cache = (struct dependancy_cache_struct*)callbackdata;
+  const struct dependancy_cache_entry_struct* cacheentry;
+  char fullpath[PATH_MAX];
+  struct stat statbuf;
+  uint32_t i;
+  if (!realpath(path, fullpath) || stat(fullpath, &statbuf) != 0 || (cacheentry = dependancy_cache_find(cache, fullpath, &statbuf)) == NULL)
+    return 0;
+  //parse the file instead if the list can't be provided completely
+  for (i = 0; i < cacheentry->modulecount; i++) {
+    if (pedeps_depgraph_add_import(graph, module, cache->strings + cache->modules[cacheentry->firstmodule + i]) != PE_RESULT_SUCCESS)
+      return 0;
+  }
+  return 1;
+}
+
+//get dependancies of the requested files (each file is parsed only once, in parallel) and list all modules that were found
+void resolve_dependancies (struct dependancy_info_struct* depinfo)
+{
+  const uint32_t* dependencies;
+  uint32_t dependencycount;
+  uint32_t modulecount;
+  uint32_t i;
+  const char* path;
+  char* listpath;
+  char fullpath[PATH_MAX];
+  struct stat statbuf;
+  if (depinfo->cache)
+    pedeps_depgraph_set_imports_callback(depinfo->graph, get_cached_imports, depinfo->cache);
+  if (pedeps_depgraph_build(depinfo->graph, 0) != PE_RESULT_SUCCESS) {
+    fprintf(stderr, "Error resolving dependancies\n");
+    return;
+  }
+  modulecount = pedeps_depgraph_get_module_count(depinfo->graph);
+  for (i = 0; i < modulecount; i++) {
+    if ((path = pedeps_depgraph_get_module_path(depinfo->graph, i)) == NULL)
+      continue;
+    //add to sorted list of files
+    if ((listpath = strdup(path)) != NULL && avl_insert(depinfo->filelist, listpath) == NULL)
+      free(listpath);
+    //remember imported modules of files that were parsed
+    if (depinfo->cache && (pedeps_depgraph_get_module_flags(depinfo->graph, i) & PEDEPS_DEPGRAPH_MODULE_PARSED) && realpath(path, fullpath) && stat(fullpath, &statbuf) == 0) {
+      dependencycount = pedeps_depgraph_get_dependencies(depinfo->graph, i, &dependencies);
+      dependancy_cache_add(depinfo->cache, fullpath, &statbuf, depinfo->graph, dependencies, dependencycount);
+    }
+  }
+}
+
+void add_file_to_list (const char* filepath, struct dependancy_info_struct* depinfo)
+{
+  //dependancies are resolved later
+  if (pedeps_depgraph_add_root(depinfo->graph, filepath) != PE_RESULT_SUCCESS)
+    fprintf(stderr, "Error: unable to locate %s in PATH\n", filepath);
+}
+
+//check if both paths refer to the same file (e.g. hard links)
+int is_same_file (const char* path1, const char* path2)
+{
+#ifdef _WIN32
+  HANDLE handle1;
+  HANDLE handle2;
+  BY_HANDLE_FILE_INFORMATION info1;
+  BY_HANDLE_FILE_INFORMATION info2;
+  int result = 0;
+  if ((handle1 = CreateFileA(path1, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL)) == INVALID_HANDLE_VALUE)
+    return 0;
+  if ((handle2 = CreateFileA(path2, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL)) != INVALID_HANDLE_VALUE) {
+    if (GetFileInformationByHandle(handle1, &info1) && GetFileInformationByHandle(handle2, &info2))
+      result = (info1.dwVolumeSerialNumber == info2.dwVolumeSerialNumber && info1.nFileIndexHigh == info2.nFileIndexHigh && info1.nFileIndexLow == info2.nFileIndexLow);
+    CloseHandle(handle2);
+  }
+  CloseHandle(handle1);
+  return result;
+#else
+  struct stat statbuf1;
+  struct stat statbuf2;
+  if (stat(path1, &statbuf1) != 0 || stat(path2, &statbuf2) != 0)
+    return 0;
+  return (statbuf1.st_dev == statbuf2.st_dev && statbuf1.st_ino == statbuf2.st_ino);
+#endif
+}
+
+//link modes
+#define LINK_NONE 0
+#define LINK_HARD 1
+#define LINK_SYM 2
+#define LINK_REFLINK 3
+#define LINK_AUTO 4
+
+//create hard link (LINK_HARD or LINK_AUTO) or symbolic link (LINK_SYM) to source file, returns 0 on success
+int link_file (const char* srcfile, const char* dstfile, int linkmode)
+{
+  char fullpath[PATH_MAX];
+  if (linkmode == LINK_SYM) {
+    //use absolute path as the link is created in a different folder
+    if (!realpath(srcfile, fullpath))
+      return 1;
+#ifdef _WIN32
+    return (CreateSymbolicLinkA(dstfile, fullpath, 0) ? 0 : 1);
+#else
+    return (symlink(fullpath, dstfile) == 0 ? 0 : 1);
+#endif
+  }
+#ifdef _WIN32
+  return (CreateHardLinkA(dstfile, srcfile, NULL) ? 0 : 1);
+#else
+  return (link(srcfile, dstfile) == 0 ? 0 : 1);
+#endif
+}
+
+//messages of one file, kept until they can be shown in the right order
+struct output_message_struct {
+  FILE* stream;
+  char* text;
+  struct output_message_struct* next;
+};
+
+struct output_struct {
+  struct output_message_struct* first;
+  struct output_message_struct* last;
+};
+
+void output_printf (struct output_struct* output, FILE* stream, const char* format, ...)
 {
+  struct output_message_struct* message;
+  va_list args;
+  int len;
+  va_start(args, format);
+  len = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  if (len < 0)
+    return;
+  if ((message = (struct output_message_struct*)malloc(sizeof(struct output_message_struct))) == NULL || (message->text = (char*)malloc(len + 1)) == NULL) {
+    free(message);
+    return;
+  }
+  va_start(args, format);
+  vsnprintf(message->text, len + 1, format, args);
+  va_end(args);
+  message->stream = stream;
+  message->next = NULL;
+  if (output->last)
+    output->last->next = message;
+  else
+    output->first = message;
+  output->last = message;
+}
+
+//show and free messages
+void output_flush (struct output_struct* output)
+{
+  struct output_message_struct* message;
+  while ((message = output->first) != NULL) {
+    output->first = message->next;
+    fputs(message->text, message->stream);
+    free(message->text);
+    free(message);
+  }
+  output->last = NULL;
+}
+
+//status of deploying a file to a destination folder
+#define DEPLOY_COPIED 0
+#define DEPLOY_UNCHANGED 1
+#define DEPLOY_NOT_OVERWRITTEN 2
+#define DEPLOY_ERROR 3
+#define DEPLOY_PENDING 4
+
+//link file or determine how it should be copied to the destination (if status is DEPLOY_PENDING)
+int prepare_deploy_file (struct dependancy_info_struct* depinfo, const char* srcpath, const char* dstpath, int* copymode)
+{
+  struct stat srcstat;
+  struct stat dststat;
+  int dstexists;
+  int dstislink;
+  int samefile;
+  if (!depinfo->overwrite && file_exists(dstpath))
+    return DEPLOY_NOT_OVERWRITTEN;
+  dstexists = (lstat(dstpath, &dststat) == 0);
+  dstislink = (dstexists && S_ISLNK(dststat.st_mode));
+  samefile = (dstexists && !dstislink && is_same_file(srcpath, dstpath));
+  //destination already is a hard link to the source file
+  if (samefile && (depinfo->linkmode == LINK_HARD || depinfo->linkmode == LINK_AUTO))
+    return DEPLOY_UNCHANGED;
+  if (depinfo->syncmode == SYNC_TIME && dstexists && !dstislink && !samefile && depinfo->linkmode != LINK_SYM && stat(srcpath, &srcstat) == 0 && srcstat.st_size == dststat.st_size && srcstat.st_mtime == dststat.st_mtime)
+    return DEPLOY_UNCHANGED;
+  if (depinfo->dryrun) {
+    //compare contents in sync mode
+    *copymode = COPY_TARGET_SYNC;
+    return (depinfo->syncmode == SYNC_CONTENTS && dstexists && !dstislink && !samefile && depinfo->linkmode != LINK_SYM ? DEPLOY_PENDING : DEPLOY_COPIED);
+  }
+  //remove existing destination file if it will be replaced by a link or if writing to it would modify the source file
+  if (dstexists && (depinfo->linkmode == LINK_HARD || depinfo->linkmode == LINK_SYM || depinfo->linkmode == LINK_AUTO || dstislink || samefile))
+    unlink(dstpath);
+  if ((depinfo->linkmode == LINK_HARD || depinfo->linkmode == LINK_SYM || depinfo->linkmode == LINK_AUTO) && link_file(srcpath, dstpath, depinfo->linkmode) == 0)
+    return DEPLOY_COPIED;
+  //fall back to copying (e.g. when linking across file systems)
+  *copymode = (depinfo->syncmode == SYNC_CONTENTS ? COPY_TARGET_SYNC : (depinfo->overwrite ? COPY_TARGET_OVERWRITE : COPY_TARGET_CREATE));
+  return DEPLOY_PENDING;
+}
+
+//copy or link file to all destination folders unless it shouldn't be overwritten or is unchanged (in sync mode)
+void deploy_file (struct dependancy_info_struct* depinfo, const char* srcpath, const char* filename, struct output_struct* output)
+{
+  struct destination_struct* destination;
+  struct copy_target_struct* targets;
+  char** dstpaths;
+  int* statuses;
   size_t filenamelen;
-  struct string_list_struct* p;
-  char* s;
-  size_t l;
-  if (!filename || !*filename)
-    return NULL;
-  if (file_exists(filename))
-    return strdup(filename);
+  size_t targetcount = 0;
+  size_t i;
+  size_t j;
+  //allocate status for each destination
+  dstpaths = (char**)calloc(depinfo->destinationcount, sizeof(char*));
+  statuses = (int*)malloc(depinfo->destinationcount * sizeof(int));
+  targets = (struct copy_target_struct*)malloc(depinfo->destinationcount * sizeof(struct copy_target_struct));
+  if (!dstpaths || !statuses || !targets) {
+    output_printf(output, stderr, "Memory allocation error\n");
+    free(dstpaths);
+    free(statuses);
+    free(targets);
+    return;
+  }
+  //link file or determine which destinations need to be copied
   filenamelen = strlen(filename);
-  //check preferred path
-  if ((s = (char*)malloc((l = strlen(preferredpath)) + filenamelen + 2)) != NULL) {
-    memcpy(s, preferredpath, l);
-    s[l] = PATHSEPARATOR;
-    memcpy(s + l + 1, filename, filenamelen + 1);
-    if (file_exists(s))
-      return s;
-    free(s);
-  }
-  //check search path
-  p = pathlist;
-  while (p) {
-    if ((s = (char*)malloc((l = strlen(p->data)) + filenamelen + 2)) != NULL) {
-      memcpy(s, p->data, l);
-      s[l] = PATHSEPARATOR;
-      memcpy(s + l + 1, filename, filenamelen + 1);
-      if (file_exists(s))
-        return s;
-      free(s);
+  for (i = 0, destination = depinfo->destinations; destination; i++, destination = destination->next) {
+    if ((dstpaths[i] = (char*)malloc(destination->pathlen + filenamelen + 1)) == NULL) {
+      statuses[i] = DEPLOY_ERROR;
+      continue;
     }
-    p = p->next;
+    memcpy(dstpaths[i], destination->path, destination->pathlen);
+    memcpy(dstpaths[i] + destination->pathlen, filename, filenamelen + 1);
+    if ((statuses[i] = prepare_deploy_file(depinfo, srcpath, dstpaths[i], &targets[targetcount].mode)) == DEPLOY_PENDING)
+      targets[targetcount++].path = dstpaths[i];
   }
-  return NULL;
+  //copy to all remaining destinations at once
+  if (targetcount > 0) {
+    copy_file_multiple(srcpath, targets, targetcount, depinfo->dryrun);
+    for (i = 0, j = 0; i < depinfo->destinationcount; i++) {
+      if (statuses[i] == DEPLOY_PENDING) {
+        statuses[i] = (targets[j].result == 0 ? DEPLOY_COPIED : (targets[j].result < 0 ? DEPLOY_UNCHANGED : DEPLOY_ERROR));
+        j++;
+      }
+    }
+  }
+  //report results (counters are shared by all copy workers)
+  pe_mutex_lock(&depinfo->lock);
+  for (i = 0, destination = depinfo->destinations; destination; i++, destination = destination->next) {
+    switch (statuses[i]) {
+      case DEPLOY_COPIED:
+        destination->copiedcount++;
+        if (depinfo->verbose >= (depinfo->dryrun ? 1 : 2))
+          output_printf(output, stdout, "%s -> %s\n", srcpath, dstpaths[i]);
+        break;
+      case DEPLOY_UNCHANGED:
+        destination->skippedcount++;
+        if (depinfo->verbose >= 2)
+          output_printf(output, stdout, "Unchanged: %s\n", dstpaths[i]);
+        break;
+      case DEPLOY_NOT_OVERWRITTEN:
+        destination->skippedcount++;
+        if (depinfo->verbose >= 1)
+          output_printf(output, stdout, "Not overwriting existing file: %s\n", dstpaths[i]);
+        break;
+      default:
+        output_printf(output, stderr, "Error copying %s to %s%s\n", srcpath, destination->path, filename);
+        break;
+    }
+    free(dstpaths[i]);
+  }
+  pe_mutex_unlock(&depinfo->lock);
+  free(dstpaths);
+  free(statuses);
+  free(targets);
 }
 
-int add_dependancies (struct dependancy_info_struct* depinfo, const char* filename);
+//file to be copied by the copy workers
+struct copy_item_struct {
+  const char* path;
+  const char* filename;
+  size_t nextsamename;    //index + 1 of the next file with the same name (copied after this one by the same worker)
+  size_t lastsamename;    //index + 1 of the last file with the same name (only used for the first one)
+  int follows;            //set if another file with the same name comes first
+  int done;
+  struct output_struct output;
+};
+
+struct copy_pool_struct {
+  struct dependancy_info_struct* depinfo;
+  struct copy_item_struct* items;
+  size_t count;
+  size_t next;
+  size_t nextoutput;
+  pe_mutex lock;
+};
 
-int iterate_dependancies_add (const char* modulename, const char* functionname, void* callbackdata)
+//copy files until all are taken, showing the output of finished files in the original order
+PE_THREAD_FN(copy_worker_thread, arg)
 {
-  struct dependancy_info_struct* depinfo = (struct dependancy_info_struct*)callbackdata;
-  if (modulename) {
-    char* path;
-    if ((path = search_path(depinfo->preferredpath, depinfo->pathlist, modulename)) != NULL) {
-      //new module, recursively add dependancies if wanted
-      if (avl_insert(depinfo->filelist, path) != NULL) {
-        if (depinfo->recursive) {
-          add_dependancies(depinfo, path);
-        }
-      } else {
-        //module already listed, no further action needed
-        free(path);
-      }
+  struct copy_pool_struct* pool = (struct copy_pool_struct*)arg;
+  size_t i;
+  pe_mutex_lock(&pool->lock);
+  while (pool->next < pool->count) {
+    i = pool->next++;
+    if (pool->items[i].follows)
+      continue;
+    pe_mutex_unlock(&pool->lock);
+    while (1) {
+      deploy_file(pool->depinfo, pool->items[i].path, pool->items[i].filename, &pool->items[i].output);
+      pe_mutex_lock(&pool->lock);
+      pool->items[i].done = 1;
+      while (pool->nextoutput < pool->count && pool->items[pool->nextoutput].done)
+        output_flush(&pool->items[pool->nextoutput++].output);
+      if (pool->items[i].nextsamename == 0)
+        break;
+      i = pool->items[i].nextsamename - 1;
+      pe_mutex_unlock(&pool->lock);
     }
   }
-  return 0;
+  pe_mutex_unlock(&pool->lock);
+  return PE_THREAD_RETURN;
 }
 
-int add_dependancies (struct dependancy_info_struct* depinfo, const char* filename)
+//compare file names of files to be copied
+int copy_item_filename_cmp (const struct copy_item_struct* item1, const struct copy_item_struct* item2)
 {
-  pefile_handle pehandle;
-  char* path;
-  //determine path
-  if ((path = search_path(depinfo->preferredpath, depinfo->pathlist, filename)) == NULL) {
-    fprintf(stderr, "Error: unable to locate %s in PATH\n", filename);
-    return 1;
+  return strcmp(item1->filename, item2->filename);
+}
+
+int copy_item_filename_casecmp (const struct copy_item_struct* item1, const struct copy_item_struct* item2)
+{
+  return strcasecmp(item1->filename, item2->filename);
+}
+
+//copy all files in the list using the specified number of workers
+void deploy_files (struct dependancy_info_struct* depinfo, unsigned int workers)
+{
+  struct copy_pool_struct pool;
+  avl_tree_t* filenames;
+  avl_node_t* entry;
+  avl_node_t* samename;
+  pe_thread* threads;
+  unsigned int threadcount;
+  unsigned int i;
+  size_t first;
+  //list files to copy (files with the same name are copied in order by the same worker)
+  if ((filenames = avl_alloc_tree((avl_compare_t)(depinfo->casefold ? copy_item_filename_casecmp : copy_item_filename_cmp), NULL)) == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    return;
   }
-  //create PE object
-  if ((pehandle = pefile_create()) == NULL) {
-    fprintf(stderr, "Error creating PE handle\n");
-    return 2;
+  if ((pool.items = (struct copy_item_struct*)malloc((avl_count(depinfo->filelist) + 1) * sizeof(struct copy_item_struct))) == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    avl_free_tree(filenames);
+    return;
   }
-  //open PE file
-  if (pefile_open_file(pehandle, path) == 0) {
-    //check all dependancies
-    pefile_list_imports(pehandle, iterate_dependancies_add, depinfo);
-    //close PE file
-    pefile_close(pehandle);
+  pool.count = 0;
+  i = 0;
+  while ((entry = avl_at(depinfo->filelist, i++)) != NULL) {
+    if ((pool.items[pool.count].filename = get_filename_from_path((const char*)entry->item)) == NULL)
+      continue;
+    pool.items[pool.count].path = (const char*)entry->item;
+    pool.items[pool.count].nextsamename = 0;
+    pool.items[pool.count].lastsamename = pool.count + 1;
+    pool.items[pool.count].follows = 0;
+    pool.items[pool.count].done = 0;
+    pool.items[pool.count].output.first = NULL;
+    pool.items[pool.count].output.last = NULL;
+    if ((samename = avl_search(filenames, &pool.items[pool.count])) != NULL) {
+      first = (struct copy_item_struct*)samename->item - pool.items;
+      pool.items[pool.items[first].lastsamename - 1].nextsamename = pool.count + 1;
+      pool.items[first].lastsamename = pool.count + 1;
+      pool.items[pool.count].follows = 1;
+    } else {
+      avl_insert(filenames, &pool.items[pool.count]);
+    }
+    pool.count++;
   }
-  //destroy PE object
-  pefile_destroy(pehandle);
-  //clean up
-  free(path);
-  return 0;
+  avl_free_tree(filenames);
+  pool.depinfo = depinfo;
+  pool.next = 0;
+  pool.nextoutput = 0;
+  pe_mutex_init(&pool.lock);
+  //start additional workers
+  threadcount = (workers > 1 ? workers - 1 : 0);
+  if (threadcount > pool.count)
+    threadcount = pool.count;
+  if (threadcount == 0 || (threads = (pe_thread*)malloc(sizeof(pe_thread) * threadcount)) == NULL) {
+    threads = NULL;
+    threadcount = 0;
+  }
+  for (i = 0; i < threadcount; i++) {
+    if (pe_thread_create(&threads[i], copy_worker_thread, &pool) != 0)
+      break;
+  }
+  threadcount = i;
+  //copy files on the current thread as well
+  copy_worker_thread(&pool);
+  for (i = 0; i < threadcount; i++)
+    pe_thread_join(threads[i]);
+  free(threads);
+  pe_mutex_destroy(&pool.lock);
+  free(pool.items);
 }
 
-void add_file_to_list (const char* filepath, struct dependancy_info_struct* depinfo)
+//add destination folder, returns non-zero on error
+int add_destination (struct dependancy_info_struct* depinfo, const char* folder)
 {
-  //add current file
-  avl_insert(depinfo->filelist, strdup(filepath));
-  //determine preferred path (same folder as current file)
-  depinfo->preferredpath = get_base_path(filepath);
-  //add dependancies
-  add_dependancies(depinfo, filepath);
-  //clean up preferred path
-  free(depinfo->preferredpath);
-  depinfo->preferredpath = NULL;
+  struct destination_struct** p;
+  size_t len;
+  if ((len = strlen(folder)) == 0) {
+    fprintf(stderr, "Empty destination folder name not allowed\n");
+    return 1;
+  }
+  if (!folder_exists(folder)) {
+    fprintf(stderr, "Destination folder not found: %s\n", folder);
+    return 2;
+  }
+  p = &depinfo->destinations;
+  while (*p)
+    p = &((*p)->next);
+  if ((*p = (struct destination_struct*)malloc(sizeof(struct destination_struct))) == NULL || ((*p)->path = (char*)malloc(len + 2)) == NULL) {
+    free(*p);
+    *p = NULL;
+    fprintf(stderr, "Memory allocation error\n");
+    return 3;
+  }
+  memcpy((*p)->path, folder, len + 1);
+  if (!ISPATHSEPARATOR((*p)->path[len - 1])) {
+    (*p)->path[len++] = PATHSEPARATOR;
+    (*p)->path[len] = 0;
+  }
+  (*p)->pathlen = len;
+  (*p)->folder = folder;
+  (*p)->copiedcount = 0;
+  (*p)->skippedcount = 0;
+  (*p)->next = NULL;
+  depinfo->destinationcount++;
+  return 0;
 }
 
 void show_help ()
 {
   printf(
     "Usage: " APPLICATION_NAME " [-h|-?] [-r] srcfile [...] dstfolder\n"
+    "       " APPLICATION_NAME " [-h|-?] [-r] -t dstfolder [-t dstfolder ...] srcfile [...]\n"
     "Parameters:\n"
     "  -h -?       \tdisplay command line help\n"
     "  -r          \trecursively copy dependancies\n"
+    "  -t folder   \tdestination folder, can be specified multiple times to copy\n"
+    "              \tto several folders (default: last parameter)\n"
     "  -n          \tdon't overwrite existing files\n"
     "  -d          \tdry run: don't actually copy, just display copy actions\n"
     "  -q          \tquiet mode, only show errors\n"
     "  -v          \tverbose mode (display copy actions)\n"
+    "  -i          \tcase insensitive module name matching (default on Windows)\n"
+    "  -s          \tsync mode: skip files with the same size and modification time\n"
+    "              \tin the destination and report stale files\n"
+    "  -S          \tsync mode: compare contents and only update files that differ\n"
+    "  --link=mode \tcreate links instead of copies, mode is one of: hard, sym,\n"
+    "              \treflink or auto (hard link if possible), falls back to\n"
+    "              \tcopying if the link can't be created\n"
+    "  -j n        \tnumber of files to copy at the same time\n"
+    "              \t(default: 1, 0 for one per processor)\n"
+    "  -c file     \tcache imported modules of processed files in the specified\n"
+    "              \tfile and use it on subsequent runs to skip unchanged files\n"
+    "              \t(default: value of environment variable " DEPENDANCY_CACHE_ENV ")\n"
     "Description:\n"
     "Copies .exe and .dll files and all their dependancies to the destination folder.\n"
     "Version: " PEDEPS_VERSION_STRING " (library version: %s)\n"
@@ -437,10 +1340,13 @@ void show_help ()
 int main (int argc, char* argv[])
 {
   int i;
-  char* dst;
-  size_t dstlen;
+  int lastarg;
+  int status;
+  unsigned int copyworkers = 1;
   struct dependancy_info_struct depinfo;
   avl_tree_t* filelist;
+  struct destination_struct* destination;
+  const char* cachefilename = NULL;
   //show help page if no parameters were given or help was requested
   for (i = 1; i < argc; i++) {
     if (argv[i][0] == '-' && (argv[i][1] == 'h' || argv[i][1] == '?') && argv[i][2] == 0)
@@ -450,24 +1356,6 @@ int main (int argc, char* argv[])
     show_help();
     return 0;
   }
-  //check if last parameter is an existing directory
-  if ((dstlen = strlen(argv[argc - 1])) == 0) {
-    fprintf(stderr, "Empty destination folder name not allowed\n");
-    return 1;
-  }
-  if ((dst = (char*)malloc(dstlen + 2)) == NULL) {
-    fprintf(stderr, "Memory allocation error\n");
-    return 1;
-  }
-  memcpy(dst, argv[argc - 1], dstlen + 1);
-  if (!ISPATHSEPARATOR(dst[dstlen - 1])) {
-    dst[dstlen++] = PATHSEPARATOR;
-    dst[dstlen] = 0;
-  }
-  if (!folder_exists(argv[argc - 1])) {
-    fprintf(stderr, "Destination folder not found: %s\n", dst);
-    return 2;
-  }
   //initialize sorted list (AVL tree)
   if ((filelist = avl_alloc_tree((avl_compare_t)PATHCMP, free)) == NULL) {
     fprintf(stderr, "Memory allocation error\n");
@@ -478,15 +1366,50 @@ int main (int argc, char* argv[])
   depinfo.overwrite = 1;
   depinfo.dryrun = 0;
   depinfo.verbose = 1;
+#ifdef _WIN32
+  depinfo.casefold = 1;
+#else
+  depinfo.casefold = 0;
+#endif
   depinfo.filelist = filelist;
-  depinfo.preferredpath = NULL;
-  depinfo.pathlist = NULL;
-  //determine search path
-  iterate_path_list(getenv("PATH"), 0, iterate_path_add, &depinfo.pathlist);
+  depinfo.graph = NULL;
+  depinfo.cache = NULL;
+  depinfo.syncmode = SYNC_NONE;
+  depinfo.linkmode = LINK_NONE;
+  depinfo.destinations = NULL;
+  depinfo.destinationcount = 0;
+  pe_mutex_init(&depinfo.lock);
+  //determine destination folders, recursion and case insensitive matching (must be known before folders are indexed)
+  for (i = 1; i < argc; i++) {
+    if (argv[i][0] == '-' && argv[i][1] == 'i' && argv[i][2] == 0) {
+      depinfo.casefold = 1;
+    } else if (argv[i][0] == '-' && argv[i][1] == 'r' && argv[i][2] == 0) {
+      depinfo.recursive = 1;
+    } else if (argv[i][0] == '-' && (argv[i][1] == 'c' || argv[i][1] == 'j') && argv[i][2] == 0 && i + 1 < argc) {
+      i++;
+    } else if (argv[i][0] == '-' && argv[i][1] == 't' && argv[i][2] == 0 && i + 1 < argc) {
+      if ((status = add_destination(&depinfo, argv[++i])) != 0)
+        return status;
+    }
+  }
+  //if no destination folders were specified the last parameter is the destination folder
+  if (depinfo.destinations) {
+    lastarg = argc;
+  } else {
+    lastarg = argc - 1;
+    if ((status = add_destination(&depinfo, argv[lastarg])) != 0)
+      return status;
+  }
+  //create dependancy graph and index search path (current folder and folder of each file are searched first)
+  if ((depinfo.graph = pedeps_depgraph_create(PEDEPS_DEPGRAPH_SEARCH_CURRENT_FOLDER | PEDEPS_DEPGRAPH_SEARCH_ROOT_FOLDER | (depinfo.casefold ? PEDEPS_DEPGRAPH_CASE_INSENSITIVE : 0) | (depinfo.recursive ? 0 : PEDEPS_DEPGRAPH_DIRECT_ONLY))) == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    return 3;
+  }
+  iterate_path_list(getenv("PATH"), 0, iterate_path_add, &depinfo);
   //process all parameters and get dependancies of the requested files
-  for (i = 1; i < argc - 1; i++) {
+  for (i = 1; i < lastarg; i++) {
     if (argv[i][0] == '-' && argv[i][1] == 'r' && argv[i][2] == 0) {
-      depinfo.recursive = 1;
+      //already processed
     } else if (argv[i][0] == '-' && argv[i][1] == 'n' && argv[i][2] == 0) {
       depinfo.overwrite = 0;
     } else if (argv[i][0] == '-' && argv[i][1] == 'd' && argv[i][2] == 0) {
@@ -495,6 +1418,32 @@ int main (int argc, char* argv[])
       depinfo.verbose = 0;
     } else if (argv[i][0] == '-' && argv[i][1] == 'v' && argv[i][2] == 0) {
       depinfo.verbose++;
+    } else if (argv[i][0] == '-' && argv[i][1] == 'i' && argv[i][2] == 0) {
+      //already processed
+    } else if (argv[i][0] == '-' && argv[i][1] == 's' && argv[i][2] == 0) {
+      depinfo.syncmode = SYNC_TIME;
+    } else if (argv[i][0] == '-' && argv[i][1] == 'S' && argv[i][2] == 0) {
+      depinfo.syncmode = SYNC_CONTENTS;
+    } else if (strncmp(argv[i], "--link=", 7) == 0) {
+      if (strcmp(argv[i] + 7, "hard") == 0) {
+        depinfo.linkmode = LINK_HARD;
+      } else if (strcmp(argv[i] + 7, "sym") == 0) {
+        depinfo.linkmode = LINK_SYM;
+      } else if (strcmp(argv[i] + 7, "reflink") == 0) {
+        depinfo.linkmode = LINK_REFLINK;
+      } else if (strcmp(argv[i] + 7, "auto") == 0) {
+        depinfo.linkmode = LINK_AUTO;
+      } else {
+        fprintf(stderr, "Invalid link mode: %s\n", argv[i] + 7);
+        return 1;
+      }
+    } else if (argv[i][0] == '-' && argv[i][1] == 't' && argv[i][2] == 0 && i + 1 < lastarg) {
+      //already processed
+      i++;
+    } else if (argv[i][0] == '-' && argv[i][1] == 'c' && argv[i][2] == 0 && i + 1 < lastarg) {
+      cachefilename = argv[++i];
+    } else if (argv[i][0] == '-' && argv[i][1] == 'j' && argv[i][2] == 0 && i + 1 < lastarg) {
+      copyworkers = strtoul(argv[++i], NULL, 10);
     } else {
       if (folder_exists(argv[i])) {
         DIR* dirhandle;
@@ -538,39 +1487,64 @@ int main (int argc, char* argv[])
       }
     }
   }
-  //free search path
-  string_list_free(&depinfo.pathlist);
+  //load cache
+  if (!cachefilename || !*cachefilename)
+    cachefilename = getenv(DEPENDANCY_CACHE_ENV);
+  if (cachefilename && *cachefilename && (depinfo.cache = dependancy_cache_open(cachefilename)) == NULL)
+    fprintf(stderr, "Error opening cache file: %s\n", cachefilename);
+  //get dependancies of the requested files
+  resolve_dependancies(&depinfo);
+  //update cache
+  if (depinfo.cache) {
+    if (dependancy_cache_save(depinfo.cache) != 0)
+      fprintf(stderr, "Error writing cache file: %s\n", cachefilename);
+    dependancy_cache_close(depinfo.cache);
+  }
+  pedeps_depgraph_destroy(depinfo.graph);
   //copy dependancies
-  avl_node_t* entry;
-  unsigned int entryindex = 0;
-  while ((entry = avl_at(filelist, entryindex)) != NULL) {
+  deploy_files(&depinfo, (copyworkers > 0 ? copyworkers : get_processor_count()));
+  //report files in the destination folders that are not part of the copied files
+  if (depinfo.syncmode != SYNC_NONE) {
+    DIR* dirhandle;
+    struct dirent* direntry;
+    avl_tree_t* dstnames;
+    avl_node_t* entry;
     const char* filename;
-    char* dstpath;
-    if ((filename = get_filename_from_path((const char*)entry->item)) != NULL) {
-      if ((dstpath = (char*)malloc(dstlen + strlen(filename) + 1)) != NULL) {
-        memcpy(dstpath, dst, dstlen);
-        strcpy(dstpath + dstlen, filename);
-        if (!depinfo.overwrite && file_exists(dstpath)) {
-          if (depinfo.verbose >= 1)
-            printf("Not overwriting existing file: %s\n", dstpath);
-        } else {
-          if (depinfo.dryrun) {
+    size_t len;
+    unsigned long stalecount;
+    if ((dstnames = avl_alloc_tree((avl_compare_t)(depinfo.casefold ? strcasecmp : strcmp), NULL)) == NULL) {
+      fprintf(stderr, "Memory allocation error\n");
+      return 3;
+    }
+    for (i = 0; (entry = avl_at(filelist, i)) != NULL; i++) {
+      if ((filename = get_filename_from_path((const char*)entry->item)) != NULL)
+        avl_insert(dstnames, (void*)filename);
+    }
+    for (destination = depinfo.destinations; destination; destination = destination->next) {
+      stalecount = 0;
+      if ((dirhandle = opendir(destination->folder)) != NULL) {
+        while ((direntry = readdir(dirhandle)) != NULL) {
+          len = strlen(direntry->d_name);
+          if (len >= 4 && (strcasecmp(direntry->d_name + len - 4, ".dll") == 0 || strcasecmp(direntry->d_name + len - 4, ".exe") == 0) && !avl_search(dstnames, direntry->d_name)) {
+            stalecount++;
             if (depinfo.verbose >= 1)
-              printf("%s -> %s\n", (const char*)entry->item, dstpath);
-          } else {
-            if (copy_file((const char*)entry->item, dstpath, depinfo.overwrite) != 0)
-              fprintf(stderr, "Error copying %s to %s\n", (const char*)entry->item, dstpath);
-            else if (depinfo.verbose >= 2)
-              printf("%s -> %s\n", (const char*)entry->item, dstpath);
+              printf("Stale file in destination: %s%s\n", destination->path, direntry->d_name);
           }
         }
-        free(dstpath);
+        closedir(dirhandle);
       }
+      if (depinfo.verbose >= 1)
+        printf("Copied: %lu, unchanged: %lu, stale: %lu%s%s\n", destination->copiedcount, destination->skippedcount, stalecount, (depinfo.destinationcount > 1 ? " in " : ""), (depinfo.destinationcount > 1 ? destination->path : ""));
     }
-    entryindex++;
+    avl_free_tree(dstnames);
   }
   //clean up
+  pe_mutex_destroy(&depinfo.lock);
   avl_free_tree(filelist);
-  free(dst);
+  while ((destination = depinfo.destinations) != NULL) {
+    depinfo.destinations = destination->next;
+    free(destination->path);
+    free(destination);
+  }
   return 0;
 }